@@ -0,0 +1,344 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Alpha-beta (negamax, principal variation search) with iterative deepening, killer
+// and history move ordering and a lock-free transposition table, shared by all threads
+// (lazy SMP). An alternative to Mcts::compute_move, for tactical (end-game) positions.
+//
+// Works on the same state interface, i.e. availableMoves, moveHashWinner, terminal and
+// winner, the transposition table is keyed by zobrist ( ).
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <experimental/fixed_capacity_vector>
+
+namespace AlphaBeta {
+
+struct ComputeOptions {
+
+    int number_of_threads;
+    int max_depth;
+    float max_time;
+    std::size_t table_size; // in bytes, of the transposition table, rounded down to a power of 2.
+    bool verbose;
+
+    ComputeOptions ( ) :
+        number_of_threads ( 1 ), max_depth ( 64 ), max_time ( 30.0f ), table_size ( std::size_t{ 1 } << 24 ), verbose ( true ) {}
+};
+
+using Score = int;
+
+inline constexpr Score const win_score = 30'000, max_ply = 128, mate_bound = win_score - max_ply;
+
+// A lock-free transposition table, an entry is stored as key ^ data and data, a torn
+// write (by another thread) makes the key check fail, the entry is then just a miss.
+class TranspositionTable {
+
+    public:
+    enum Bound : std::uint64_t { none = 0, upper = 1, lower = 2, exact = 3 };
+
+    struct Entry {
+        int move; // Dense index of the best move, -1 is none.
+        Score score;
+        int depth;
+        Bound bound;
+    };
+
+    explicit TranspositionTable ( std::size_t const bytes_ ) {
+        std::size_t n = 1;
+        while ( ( n << 1 ) * sizeof ( Slot ) <= bytes_ )
+            n <<= 1;
+        m_mask  = n - 1;
+        m_slots = std::make_unique<Slot[]> ( n );
+    }
+
+    [[nodiscard]] bool probe ( std::uint64_t const key_, Entry & entry_ ) const noexcept {
+        Slot const & slot     = m_slots[ key_ & m_mask ];
+        std::uint64_t const k = slot.key.load ( std::memory_order_relaxed ), d = slot.data.load ( std::memory_order_relaxed );
+        if ( ( k ^ d ) != key_ or not d )
+            return false;
+        entry_ = unpack ( d );
+        return true;
+    }
+
+    // Depth-preferred, but a different position always replaces.
+    void store ( std::uint64_t const key_, Entry const & entry_ ) noexcept {
+        Slot & slot           = m_slots[ key_ & m_mask ];
+        std::uint64_t const k = slot.key.load ( std::memory_order_relaxed ), d = slot.data.load ( std::memory_order_relaxed );
+        if ( ( k ^ d ) == key_ and d and unpack ( d ).depth > entry_.depth and exact != entry_.bound )
+            return;
+        std::uint64_t const data = pack ( entry_ );
+        slot.key.store ( key_ ^ data, std::memory_order_relaxed );
+        slot.data.store ( data, std::memory_order_relaxed );
+    }
+
+    private:
+    struct Slot {
+        std::atomic<std::uint64_t> key{ 0u }, data{ 0u };
+    };
+
+    // | bound 2 | depth 8 | score 16 | move + 1 24 |, never 0 as bound is never none.
+    [[nodiscard]] static std::uint64_t pack ( Entry const & e_ ) noexcept {
+        return static_cast<std::uint64_t> ( e_.move + 1 ) |
+               static_cast<std::uint64_t> ( static_cast<std::uint16_t> ( e_.score ) ) << 24 |
+               static_cast<std::uint64_t> ( e_.depth & 0xff ) << 40 | static_cast<std::uint64_t> ( e_.bound ) << 48;
+    }
+    [[nodiscard]] static Entry unpack ( std::uint64_t const d_ ) noexcept {
+        return Entry{ static_cast<int> ( d_ & 0xff'ffff ) - 1, static_cast<std::int16_t> ( ( d_ >> 24 ) & 0xffff ),
+                      static_cast<int> ( ( d_ >> 40 ) & 0xff ), static_cast<Bound> ( ( d_ >> 48 ) & 0x3 ) };
+    }
+
+    std::unique_ptr<Slot[]> m_slots;
+    std::size_t m_mask;
+};
+
+// Counts, for both players, the number of empty neighbors (liberties) of every stone.
+// A stone with few liberties is close to being surrounded, the fewer liberties the
+// opponent's stones have (and the more own stones have) the better, from the point of
+// view of the player to move.
+template<typename State>
+[[nodiscard]] Score evaluate ( State const & state_ ) noexcept {
+    using Board           = typename State::Board;
+    auto const & board    = state_.position ( ).m_board;
+    auto const to_move    = state_.playerToMove ( );
+    Score score           = 0;
+    for ( int i = 0; i < Board::size ( ); ++i ) {
+        if ( board[ i ].vacant ( ) )
+            continue;
+        int filled = 6;
+        for ( auto const n : Board::neighbors[ i ] )
+            filled -= board[ n ].vacant ( );
+        score += ( board[ i ] == to_move ? -1 : 1 ) * filled * filled;
+    }
+    return score;
+}
+
+template<typename State>
+class Searcher {
+
+    public:
+    using Move  = typename State::Move;
+    using Moves = std::experimental::fixed_capacity_vector<Move, std::size_t{ State::Board::size ( ) } * std::size_t{ 2 }>;
+    using Keys  = std::array<int, std::size_t{ State::Board::size ( ) } * std::size_t{ 2 }>;
+
+    Searcher ( TranspositionTable & table_, std::atomic<bool> & stop_ ) noexcept : m_table ( table_ ), m_stop ( stop_ ) {}
+
+    // Iterative deepening, returns the best move and its score of the deepest completed iteration.
+    std::pair<Move, Score> search ( State const & root_state_, ComputeOptions const & options_, int const start_depth_ ) {
+        Move best_move   = State::no_move;
+        Score best_score = 0;
+        double const start_time = now ( );
+        m_deadline              = options_.max_time >= 0 ? start_time + options_.max_time : std::numeric_limits<double>::max ( );
+        for ( int depth = start_depth_; depth <= options_.max_depth; ++depth ) {
+            m_root_move       = State::no_move;
+            Score const score = negamax ( root_state_, depth, 0, -win_score, win_score );
+            if ( m_stop.load ( std::memory_order_relaxed ) ) {
+                if ( State::no_move == best_move ) // Better than nothing.
+                    best_move = m_root_move;
+                break;
+            }
+            best_move  = m_root_move;
+            best_score = score;
+            if ( options_.verbose ) {
+                double const elapsed = now ( ) - start_time;
+                std::cerr << "depth " << depth << " score " << score << " move " << best_move << " nodes " << m_nodes << " ("
+                          << static_cast<std::int64_t> ( m_nodes / std::max ( elapsed, 1e-6 ) ) << " / second)" << std::endl;
+            }
+            if ( std::abs ( score ) >= mate_bound or m_stop.load ( std::memory_order_relaxed ) )
+                break;
+        }
+        return { best_move, best_score };
+    }
+
+    [[nodiscard]] std::int64_t nodes ( ) const noexcept { return m_nodes; }
+
+    private:
+    [[nodiscard]] static double now ( ) noexcept {
+        return std::chrono::duration<double> ( std::chrono::steady_clock::now ( ).time_since_epoch ( ) ).count ( );
+    }
+
+    // Mate scores are stored relative to the node, not to the root.
+    [[nodiscard]] static Score to_table ( Score const s_, int const ply_ ) noexcept {
+        return s_ >= mate_bound ? s_ + ply_ : s_ <= -mate_bound ? s_ - ply_ : s_;
+    }
+    [[nodiscard]] static Score from_table ( Score const s_, int const ply_ ) noexcept {
+        return s_ >= mate_bound ? s_ - ply_ : s_ <= -mate_bound ? s_ + ply_ : s_;
+    }
+
+    // The TT move first, then the killers, then by history.
+    void order ( Moves const & moves_, Keys & keys_, int const tt_move_, int const ply_ ) const noexcept {
+        constexpr int top = std::numeric_limits<int>::max ( );
+        for ( std::size_t i = 0; i < moves_.size ( ); ++i ) {
+            int const m = moves_[ i ].dense_index ( );
+            if ( m == tt_move_ )
+                keys_[ i ] = top;
+            else if ( m == m_killers[ ply_ ][ 0 ] )
+                keys_[ i ] = top - 1;
+            else if ( m == m_killers[ ply_ ][ 1 ] )
+                keys_[ i ] = top - 2;
+            else
+                keys_[ i ] = m_history[ m ];
+        }
+    }
+
+    // Brings the best of the remaining moves to the front, i.e. a lazy selection sort.
+    static void pick ( Moves & moves_, Keys & keys_, std::size_t const i_ ) noexcept {
+        std::size_t best = i_;
+        for ( std::size_t j = i_ + 1; j < moves_.size ( ); ++j )
+            if ( keys_[ j ] > keys_[ best ] )
+                best = j;
+        std::swap ( moves_[ i_ ], moves_[ best ] );
+        std::swap ( keys_[ i_ ], keys_[ best ] );
+    }
+
+    Score negamax ( State const & state_, int const depth_, int const ply_, Score alpha_, Score const beta_ ) {
+        if ( not( ++m_nodes & 1023 ) and now ( ) >= m_deadline )
+            m_stop.store ( true, std::memory_order_relaxed );
+        if ( m_stop.load ( std::memory_order_relaxed ) )
+            return 0;
+        if ( depth_ <= 0 or ply_ >= max_ply - 1 )
+            return evaluate ( state_ );
+        std::uint64_t const key = state_.zobrist ( );
+        int tt_move             = -1;
+        if ( TranspositionTable::Entry e; m_table.probe ( key, e ) ) {
+            tt_move = e.move;
+            if ( ply_ and e.depth >= depth_ ) {
+                Score const s = from_table ( e.score, ply_ );
+                if ( TranspositionTable::exact == e.bound or ( TranspositionTable::lower == e.bound and s >= beta_ ) or
+                     ( TranspositionTable::upper == e.bound and s <= alpha_ ) )
+                    return s;
+            }
+        }
+        Moves moves;
+        ( void ) state_.availableMoves ( moves );
+        Keys keys;
+        order ( moves, keys, tt_move, ply_ );
+        Score const alpha = alpha_;
+        Score best_score  = -win_score;
+        int best_move     = -1;
+        for ( std::size_t i = 0; i < moves.size ( ); ++i ) {
+            pick ( moves, keys, i );
+            State child = state_;
+            child.moveHashWinner ( moves[ i ] );
+            Score score;
+            if ( child.terminal ( ) ) {
+                if ( child.winner ( ).vacant ( ) )
+                    score = 0;
+                else
+                    score = child.winner ( ) == state_.playerToMove ( ) ? win_score - ply_ - 1 : -win_score + ply_ + 1;
+            }
+            else if ( not i )
+                score = -negamax ( child, depth_ - 1, ply_ + 1, -beta_, -alpha_ );
+            else {
+                // Principal variation search, a null-window search first, re-search iff it fails high.
+                score = -negamax ( child, depth_ - 1, ply_ + 1, -alpha_ - 1, -alpha_ );
+                if ( score > alpha_ and score < beta_ )
+                    score = -negamax ( child, depth_ - 1, ply_ + 1, -beta_, -alpha_ );
+            }
+            if ( m_stop.load ( std::memory_order_relaxed ) )
+                return 0;
+            if ( score > best_score ) {
+                best_score = score;
+                best_move  = moves[ i ].dense_index ( );
+                if ( not ply_ )
+                    m_root_move = moves[ i ];
+            }
+            if ( score > alpha_ )
+                alpha_ = score;
+            if ( alpha_ >= beta_ ) {
+                if ( moves[ i ].dense_index ( ) != m_killers[ ply_ ][ 0 ] ) {
+                    m_killers[ ply_ ][ 1 ] = m_killers[ ply_ ][ 0 ];
+                    m_killers[ ply_ ][ 0 ] = moves[ i ].dense_index ( );
+                }
+                m_history[ moves[ i ].dense_index ( ) ] += depth_ * depth_;
+                break;
+            }
+        }
+        if ( moves.empty ( ) ) // No moves, let's call it a draw.
+            best_score = 0;
+        TranspositionTable::Bound const bound = best_score >= beta_
+                                                    ? TranspositionTable::lower
+                                                    : best_score > alpha ? TranspositionTable::exact : TranspositionTable::upper;
+        m_table.store ( key, TranspositionTable::Entry{ best_move, to_table ( best_score, ply_ ), depth_, bound } );
+        return best_score;
+    }
+
+    TranspositionTable & m_table;
+    std::atomic<bool> & m_stop;
+    double m_deadline       = 0.0;
+    std::int64_t m_nodes    = 0;
+    Move m_root_move        = State::no_move;
+    std::array<std::array<int, 2>, max_ply> m_killers = { };
+    std::vector<int> m_history                        = std::vector<int> ( Move::dense_size ( ), 0 );
+};
+
+// Searches root_state_ with options_.number_of_threads threads, that share the transposition
+// table, the helper threads start at alternating depths, the main thread decides the move.
+template<typename State>
+typename State::Move compute_move ( State const root_state_, ComputeOptions const options_ ) {
+    {
+        typename State::Moves moves = root_state_.availableMoves ( );
+        assert ( moves.size ( ) > 0 );
+        if ( 1 == moves.size ( ) )
+            return moves[ 0 ];
+    }
+    TranspositionTable table ( options_.table_size );
+    std::atomic<bool> stop{ false };
+    ComputeOptions helper_options = options_;
+    helper_options.verbose        = false;
+    std::vector<std::future<void>> helpers;
+    for ( int t = 1; t < options_.number_of_threads; ++t )
+        helpers.push_back ( std::async ( std::launch::async, [ t, &root_state_, &table, &stop, &helper_options ] ( ) {
+            Searcher<State> searcher ( table, stop );
+            searcher.search ( root_state_, helper_options, 1 + t % 2 );
+        } ) );
+    Searcher<State> searcher ( table, stop );
+    auto [ move, score ] = searcher.search ( root_state_, options_, 1 );
+    stop.store ( true, std::memory_order_relaxed );
+    for ( auto & helper : helpers )
+        helper.wait ( );
+    if ( State::no_move == move ) // Out of time before a single move was searched.
+        move = root_state_.availableMoves ( )[ 0 ];
+    if ( options_.verbose )
+        std::cerr << "best " << move << " score " << score << std::endl;
+    return move;
+}
+
+} // namespace AlphaBeta
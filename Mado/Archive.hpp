@@ -0,0 +1,277 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// An archive of fixed size (trivially copyable) records, e.g. PositionData, compressed
+// in blocks of a fixed number of records, every block on its own (LZ4, primed with a
+// dictionary trained on such records), so any record is read by decompressing only its
+// block. The blocks are compressed by a number of threads at a time.
+//
+// | header 64 | block 0 | block 1 | ... | offsets ( blocks + 1 ) x 8 |, the offsets (of
+// the blocks, from the start of the file, the last is the end of the last block) are
+// the index.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include <lz4.h>
+
+#include "Dictionary.hpp"
+#include "MappedFile.hpp"
+
+namespace Archive {
+
+// | magic 8 | version 4 | record size 4 | records per block 4 | reserved 4 | records 8 |
+// blocks 8 | dictionary 8 | index 8 | reserved 8 |.
+struct Header {
+    char magic[ 8 ]                 = { 'M', 'A', 'D', 'O', 'A', 'R', 'C', '\0' };
+    std::uint32_t version           = 1u;
+    std::uint32_t record_size       = 0u;
+    std::uint32_t records_per_block = 0u;
+    std::uint32_t reserved_0        = 0u;
+    std::uint64_t records           = 0u;
+    std::uint64_t blocks            = 0u;
+    std::uint64_t dictionary        = 0u; // the id of the dictionary.
+    std::uint64_t index             = 0u; // the offset of the index.
+    std::uint64_t reserved_1        = 0u;
+};
+
+static_assert ( sizeof ( Header ) == 64, "the blocks have to start at a 64 byte boundary" );
+
+template<typename Record>
+class Writer {
+
+    static_assert ( std::is_trivially_copyable<Record>::value, "records are compressed as they are in memory" );
+
+    public:
+    // The block size is in bytes, rounded down to whole records (at least one).
+    Writer ( std::filesystem::path const & path_, Dictionary const & dictionary_,
+             int const number_of_threads_ = static_cast<int> ( std::thread::hardware_concurrency ( ) ),
+             std::size_t const block_size_ = 4'096u ) :
+        m_path ( path_ ), m_dictionary ( dictionary_ ), m_number_of_threads ( std::max ( number_of_threads_, 1 ) ),
+        m_records_per_block ( std::max ( block_size_ / sizeof ( Record ), std::size_t{ 1 } ) ),
+        m_ostream ( path_, std::ios::binary | std::ios::trunc ) {
+        if ( not m_ostream )
+            throw std::runtime_error ( "Archive: cannot write " + path_.string ( ) );
+        Header header;
+        m_ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+        m_offsets.push_back ( sizeof ( Header ) );
+        m_pending.reserve ( batch_blocks * m_records_per_block );
+    }
+    Writer ( Writer const & ) = delete;
+    Writer ( Writer && )      = delete;
+
+    ~Writer ( ) noexcept {
+        try {
+            close ( );
+        }
+        catch ( ... ) {
+        }
+    }
+
+    Writer & operator= ( Writer const & ) = delete;
+    Writer & operator= ( Writer && ) = delete;
+
+    void append ( Record const & record_ ) {
+        m_pending.push_back ( record_ );
+        if ( m_pending.size ( ) == batch_blocks * m_records_per_block )
+            compress ( );
+    }
+
+    // Writes the remaining records, the index and the header.
+    void close ( ) {
+        if ( not m_ostream.is_open ( ) )
+            return;
+        compress ( );
+        Header header;
+        header.record_size       = static_cast<std::uint32_t> ( sizeof ( Record ) );
+        header.records_per_block = static_cast<std::uint32_t> ( m_records_per_block );
+        header.records           = m_records;
+        header.blocks            = m_offsets.size ( ) - 1u;
+        header.dictionary        = m_dictionary.id ( );
+        header.index             = m_offsets.back ( );
+        m_ostream.write ( reinterpret_cast<char const *> ( m_offsets.data ( ) ),
+                          static_cast<std::streamsize> ( m_offsets.size ( ) * sizeof ( std::uint64_t ) ) );
+        m_ostream.seekp ( 0 );
+        m_ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+        m_ostream.close ( );
+        if ( not m_ostream )
+            throw std::runtime_error ( "Archive: cannot write " + m_path.string ( ) );
+    }
+
+    [[nodiscard]] std::uint64_t records ( ) const noexcept { return m_records + m_pending.size ( ); }
+
+    private:
+    // Compresses the pending records, a block per thread at a time, and writes the blocks.
+    void compress ( ) {
+        if ( m_pending.empty ( ) )
+            return;
+        std::size_t const blocks = ( m_pending.size ( ) + m_records_per_block - 1u ) / m_records_per_block;
+        int const bound          = LZ4_compressBound ( static_cast<int> ( m_records_per_block * sizeof ( Record ) ) );
+        m_compressed.resize ( blocks );
+        std::atomic<std::size_t> next{ 0u };
+        auto work = [ & ] ( ) {
+            // The state after loading the dictionary is copied, instead of loading it for every block.
+            auto dictionary = std::make_unique<LZ4_stream_t> ( ), stream = std::make_unique<LZ4_stream_t> ( );
+            LZ4_initStream ( dictionary.get ( ), sizeof ( LZ4_stream_t ) );
+            LZ4_loadDict ( dictionary.get ( ), m_dictionary.data ( ), m_dictionary.size ( ) );
+            for ( std::size_t b; ( b = next.fetch_add ( 1u, std::memory_order_relaxed ) ) < blocks; ) {
+                std::size_t const first = b * m_records_per_block,
+                                  n     = std::min ( m_records_per_block, m_pending.size ( ) - first );
+                std::memcpy ( stream.get ( ), dictionary.get ( ), sizeof ( LZ4_stream_t ) );
+                m_compressed[ b ].resize ( static_cast<std::size_t> ( bound ) );
+                int const size = LZ4_compress_fast_continue (
+                    stream.get ( ), reinterpret_cast<char const *> ( m_pending.data ( ) + first ), m_compressed[ b ].data ( ),
+                    static_cast<int> ( n * sizeof ( Record ) ), bound, 1 );
+                m_compressed[ b ].resize ( static_cast<std::size_t> ( size ) );
+            }
+        };
+        std::vector<std::thread> threads;
+        for ( int t = 1; t < std::min ( m_number_of_threads, static_cast<int> ( blocks ) ); ++t )
+            threads.emplace_back ( work );
+        work ( );
+        for ( auto & thread : threads )
+            thread.join ( );
+        for ( auto const & c : m_compressed ) {
+            if ( c.empty ( ) )
+                throw std::runtime_error ( "Archive: cannot compress a block of " + m_path.string ( ) );
+            m_ostream.write ( c.data ( ), static_cast<std::streamsize> ( c.size ( ) ) );
+            m_offsets.push_back ( m_offsets.back ( ) + c.size ( ) );
+        }
+        if ( not m_ostream )
+            throw std::runtime_error ( "Archive: cannot write " + m_path.string ( ) );
+        m_records += m_pending.size ( );
+        m_pending.clear ( );
+    }
+
+    static constexpr std::size_t batch_blocks = 256u; // compressed at a time.
+
+    std::filesystem::path m_path;
+    Dictionary const & m_dictionary;
+    int const m_number_of_threads;
+    std::size_t const m_records_per_block;
+    std::ofstream m_ostream;
+    std::vector<Record> m_pending;
+    std::vector<std::vector<char>> m_compressed;
+    std::vector<std::uint64_t> m_offsets;
+    std::uint64_t m_records = 0u;
+};
+
+// The (memory mapped) archive, thread safe.
+template<typename Record>
+class Reader {
+
+    static_assert ( std::is_trivially_copyable<Record>::value, "records are compressed as they are in memory" );
+
+    public:
+    Reader ( std::filesystem::path const & path_, Dictionary const & dictionary_ ) :
+        m_file ( path_ ), m_dictionary ( dictionary_ ) {
+        Header expected;
+        if ( m_file.size ( ) < sizeof ( Header ) )
+            throw std::runtime_error ( "Archive: not an archive " + path_.string ( ) );
+        std::memcpy ( &m_header, m_file.data ( ), sizeof ( Header ) );
+        if ( std::memcmp ( m_header.magic, expected.magic, sizeof ( m_header.magic ) ) or expected.version != m_header.version or
+             sizeof ( Record ) != m_header.record_size or not m_header.records_per_block or m_file.size ( ) < m_header.index or
+             ( m_file.size ( ) - m_header.index ) / sizeof ( std::uint64_t ) <= m_header.blocks or
+             ( m_header.records + m_header.records_per_block - 1u ) / m_header.records_per_block != m_header.blocks )
+            throw std::runtime_error ( "Archive: wrong archive " + path_.string ( ) );
+        if ( m_dictionary.id ( ) != m_header.dictionary )
+            throw std::runtime_error ( "Archive: wrong dictionary for " + path_.string ( ) );
+        // The index is copied (it is not aligned), and checked, a block is read from [ offsets[ b ], offsets[ b + 1 ] ).
+        m_offsets.resize ( static_cast<std::size_t> ( m_header.blocks + 1u ) );
+        std::memcpy ( m_offsets.data ( ), m_file.data ( ) + m_header.index, m_offsets.size ( ) * sizeof ( std::uint64_t ) );
+        if ( m_offsets.front ( ) < sizeof ( Header ) or m_header.index < m_offsets.back ( ) or
+             std::adjacent_find ( std::begin ( m_offsets ), std::end ( m_offsets ), [] ( std::uint64_t a_, std::uint64_t b_ ) {
+                 return b_ < a_ or std::numeric_limits<int>::max ( ) < b_ - a_;
+             } ) != std::end ( m_offsets ) )
+            throw std::runtime_error ( "Archive: corrupt index of " + path_.string ( ) );
+    }
+
+    [[nodiscard]] std::uint64_t size ( ) const noexcept { return m_header.records; }
+    [[nodiscard]] std::uint64_t blocks ( ) const noexcept { return m_header.blocks; }
+    [[nodiscard]] std::size_t records_per_block ( ) const noexcept { return m_header.records_per_block; }
+
+    // Decompresses block b_ into records_ (room for records_per_block ( ) records), returns
+    // the number of records in the block.
+    std::size_t block ( std::uint64_t const b_, Record * const records_ ) const {
+        if ( b_ >= blocks ( ) )
+            throw std::runtime_error ( "Archive: no block " + std::to_string ( b_ ) );
+        std::uint64_t const first = b_ * m_header.records_per_block;
+        std::size_t const n = static_cast<std::size_t> ( std::min<std::uint64_t> ( m_header.records_per_block, size ( ) - first ) );
+        int const size      = LZ4_decompress_safe_usingDict (
+            reinterpret_cast<char const *> ( m_file.data ( ) + m_offsets[ b_ ] ), reinterpret_cast<char *> ( records_ ),
+            static_cast<int> ( m_offsets[ b_ + 1u ] - m_offsets[ b_ ] ), static_cast<int> ( n * sizeof ( Record ) ),
+            m_dictionary.data ( ), m_dictionary.size ( ) );
+        if ( size != static_cast<int> ( n * sizeof ( Record ) ) )
+            throw std::runtime_error ( "Archive: corrupt block " + std::to_string ( b_ ) );
+        return n;
+    }
+
+    // Record i_, the last block read (by this thread) is kept, so nearby reads are cheap.
+    [[nodiscard]] Record operator[] ( std::uint64_t const i_ ) const {
+        if ( i_ >= size ( ) )
+            throw std::runtime_error ( "Archive: no record " + std::to_string ( i_ ) );
+        struct Cache {
+            std::uint64_t reader = 0u, block = 0u;
+            std::vector<Record> records;
+        };
+        static thread_local Cache cache;
+        std::uint64_t const b = i_ / m_header.records_per_block;
+        if ( m_id != cache.reader or b != cache.block ) {
+            cache.reader = 0u; // Iff the block is corrupt.
+            cache.records.resize ( m_header.records_per_block );
+            block ( b, cache.records.data ( ) );
+            cache.reader = m_id;
+            cache.block  = b;
+        }
+        return cache.records[ i_ % m_header.records_per_block ];
+    }
+
+    private:
+    MappedFile m_file;
+    Dictionary const & m_dictionary;
+    Header m_header;
+    std::vector<std::uint64_t> m_offsets;
+    std::uint64_t const m_id = next_id ( ); // of this reader, never 0, identifies the cached block.
+
+    [[nodiscard]] static std::uint64_t next_id ( ) noexcept {
+        static std::atomic<std::uint64_t> id{ 0u };
+        return id.fetch_add ( 1u, std::memory_order_relaxed ) + 1u;
+    }
+};
+
+} // namespace Archive
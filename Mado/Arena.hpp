@@ -0,0 +1,270 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Engine-vs-engine matches, to accept or reject a change. The games are played
+// concurrently by a pool of game threads, every engine searches with its own options
+// (threads and time). Every opening (a few random moves) is played twice, with the
+// colours swapped. The match stops early as soon as the sequential probability ratio
+// test (on the elo difference, elo0 against elo1) is decided.
+//
+//     auto const r = Arena::match<State> ( Arena::mcts<State> ( "new", a ), Arena::mcts<State> ( "old", b ), options );
+
+#pragma once
+
+#include <cmath>
+#include <cstdint>
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <random>
+#include <string>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "GameRecord.hpp"
+#include "MonteCarlo.hpp"
+
+namespace Arena {
+
+// An engine plays a game by way of a player, a new player for every game, such that a
+// player can keep state between its moves (i.e. ponder).
+template<typename State>
+struct Engine {
+    using Move   = typename State::Move;
+    using Player = std::function<Move ( State const & )>;
+
+    std::string name;
+    std::function<Player ( )> new_game;
+};
+
+template<typename State>
+[[nodiscard]] Engine<State> mcts ( std::string name_, Mcts::ComputeOptions const & options_ ) {
+    return { std::move ( name_ ), [ options_ ] ( ) {
+                return typename Engine<State>::Player{ [ options_ ] ( State const & state_ ) {
+                    return Mcts::compute_move ( state_, options_ );
+                } };
+            } };
+}
+
+// Ponders on the time of the opponent.
+template<typename State>
+[[nodiscard]] Engine<State> ponder ( std::string name_, Mcts::ComputeOptions const & options_ ) {
+    return { std::move ( name_ ), [ options_ ] ( ) {
+                auto ponder = std::make_shared<Mcts::Ponder<State>> ( options_ );
+                return typename Engine<State>::Player{ [ ponder ] ( State const & state_ ) {
+                    auto const move = ponder->compute_move ( state_ );
+                    State state     = state_;
+                    state.moveHashWinner ( move );
+                    ponder->start ( state );
+                    return move;
+                } };
+            } };
+}
+
+struct Options {
+    int concurrency;     // the number of games played at the same time.
+    int max_games;       // rounded up to pairs of games.
+    int opening_plies;   // the number of random moves of an opening.
+    std::uint64_t seed;  // of the openings, the same seed gives the same suite.
+    double elo0, elo1;   // H0: elo <= elo0, H1: elo >= elo1, the elo of the first engine.
+    double alpha, beta;  // the probabilities of a false positive and a false negative.
+    bool sprt;           // stop as soon as the test is decided.
+    bool verbose;        // print the score after every pair of games.
+    // If not empty, the games played are recorded there (Game::Writer).
+    std::filesystem::path games;
+
+    Options ( ) :
+        concurrency ( std::max ( 1, static_cast<int> ( std::thread::hardware_concurrency ( ) ) ) ), max_games ( 10'000 ),
+        opening_plies ( 2 ), seed ( 0x4d41444f ), elo0 ( 0.0 ), elo1 ( 5.0 ), alpha ( 0.05 ), beta ( 0.05 ), sprt ( true ),
+        verbose ( true ) {}
+};
+
+// The score from the point of view of the first engine.
+struct Score {
+    int wins = 0, draws = 0, losses = 0;
+
+    [[nodiscard]] int games ( ) const noexcept { return wins + draws + losses; }
+    [[nodiscard]] double mean ( ) const noexcept { return games ( ) ? ( wins + 0.5 * draws ) / games ( ) : 0.5; }
+    [[nodiscard]] double variance ( ) const noexcept {
+        if ( not games ( ) )
+            return 0.0;
+        double const m = mean ( );
+        return ( wins * ( 1.0 - m ) * ( 1.0 - m ) + draws * ( 0.5 - m ) * ( 0.5 - m ) + losses * m * m ) / games ( );
+    }
+
+    [[nodiscard]] static double elo ( double const score_ ) noexcept {
+        double const s = std::clamp ( score_, 1e-6, 1.0 - 1e-6 );
+        return -400.0 * std::log10 ( 1.0 / s - 1.0 );
+    }
+    [[nodiscard]] static double score ( double const elo_ ) noexcept { return 1.0 / ( 1.0 + std::pow ( 10.0, -elo_ / 400.0 ) ); }
+
+    [[nodiscard]] double elo ( ) const noexcept { return elo ( mean ( ) ); }
+    // Half the width of the 95% confidence interval of the elo.
+    [[nodiscard]] double elo_error ( ) const noexcept {
+        if ( not games ( ) )
+            return 0.0;
+        double const e = 1.959964 * std::sqrt ( variance ( ) / games ( ) );
+        return ( elo ( mean ( ) + e ) - elo ( mean ( ) - e ) ) / 2.0;
+    }
+
+    // The log-likelihood ratio of H1 against H0 (the normal approximation of the
+    // trinomial GSPRT).
+    [[nodiscard]] double llr ( double const elo0_, double const elo1_ ) const noexcept {
+        double const v = variance ( );
+        if ( v <= 0.0 )
+            return 0.0;
+        double const s0 = score ( elo0_ ), s1 = score ( elo1_ );
+        return games ( ) * ( s1 - s0 ) * ( 2.0 * mean ( ) - s0 - s1 ) / ( 2.0 * v );
+    }
+};
+
+struct Result {
+    enum class Decision { none, h0, h1 }; // h1 is the first engine is stronger (by at least elo1).
+
+    Score score;
+    double llr = 0.0, lower = 0.0, upper = 0.0; // the llr and its bounds.
+    Decision decision = Decision::none;
+    double seconds    = 0.0;
+};
+
+inline std::ostream & operator<< ( std::ostream & out_, Result const & r_ ) {
+    out_ << std::fixed << std::setprecision ( 1 ) << "games " << r_.score.games ( ) << " (+" << r_.score.wins << " ="
+         << r_.score.draws << " -" << r_.score.losses << ") elo " << r_.score.elo ( ) << " +/- " << r_.score.elo_error ( )
+         << std::setprecision ( 2 ) << " llr " << r_.llr << " [" << r_.lower << ", " << r_.upper << "]";
+    switch ( r_.decision ) {
+        case Result::Decision::h0: out_ << " H0 accepted"; break;
+        case Result::Decision::h1: out_ << " H1 accepted"; break;
+        default: break;
+    }
+    return out_ << std::defaultfloat;
+}
+
+// The moves of opening i_, random, but the same for the same seed_.
+template<typename State>
+[[nodiscard]] std::vector<typename State::Move> opening ( std::uint64_t const seed_, int const i_, int const plies_ ) {
+    std::mt19937_64 rng ( seed_ ^ ( std::uint64_t{ 0x9e3779b97f4a7c15 } * static_cast<std::uint64_t> ( i_ + 1 ) ) );
+    while ( true ) {
+        std::vector<typename State::Move> moves;
+        State state;
+        while ( static_cast<int> ( moves.size ( ) ) < plies_ and state.nonterminal ( ) ) {
+            auto const available = state.availableMoves ( );
+            moves.push_back ( available[ std::uniform_int_distribution<std::size_t> ( 0u, available.size ( ) - 1u ) ( rng ) ] );
+            state.moveHashWinner ( moves.back ( ) );
+        }
+        if ( state.nonterminal ( ) )
+            return moves;
+    }
+}
+
+// Plays one game, from the opening, the first engine plays the human (moves first) iff
+// first_is_human_, returns the score of the first engine.
+template<typename State>
+[[nodiscard]] double play ( Engine<State> const & first_, Engine<State> const & second_,
+                            std::vector<typename State::Move> const & opening_, bool const first_is_human_,
+                            std::vector<typename State::Move> * moves_ = nullptr ) {
+    using Player = typename State::value_type;
+    State state;
+    for ( auto const move : opening_ )
+        state.moveHashWinner ( move );
+    if ( moves_ )
+        *moves_ = opening_;
+    auto human = ( first_is_human_ ? first_ : second_ ).new_game ( );
+    auto agent = ( first_is_human_ ? second_ : first_ ).new_game ( );
+    while ( state.nonterminal ( ) ) {
+        auto const move = state.playerToMove ( ).agent ( ) ? agent ( state ) : human ( state );
+        state.moveHashWinner ( move );
+        if ( moves_ )
+            moves_->push_back ( move );
+    }
+    Player const first = first_is_human_ ? Player{ Player::Type::human } : Player{ Player::Type::agent };
+    if ( state.winner ( ) == first )
+        return 1.0;
+    return state.winner ( ) == first.opponent ( ) ? 0.0 : 0.5;
+}
+
+// Plays the first engine against the second, the score is that of the first engine.
+template<typename State>
+[[nodiscard]] Result match ( Engine<State> const & first_, Engine<State> const & second_, Options const & options_ = Options{ } ) {
+    Result result;
+    result.lower     = std::log ( options_.beta / ( 1.0 - options_.alpha ) );
+    result.upper     = std::log ( ( 1.0 - options_.beta ) / options_.alpha );
+    auto const start = std::chrono::steady_clock::now ( );
+    int const pairs  = ( std::max ( options_.max_games, 1 ) + 1 ) / 2;
+    std::atomic<int> next{ 0 };
+    std::atomic<bool> stop{ false };
+    std::mutex mutex;
+    std::vector<double> pair_scores ( pairs, -1.0 ); // the first game of a pair stores its score.
+    std::unique_ptr<Game::Writer<State>> games;
+    if ( not options_.games.empty ( ) )
+        games = std::make_unique<Game::Writer<State>> ( options_.games );
+    auto work = [ & ] ( ) {
+        using Player = typename State::value_type;
+        std::vector<typename State::Move> moves;
+        for ( int g; not stop.load ( std::memory_order_relaxed ) and ( g = next.fetch_add ( 1 ) ) < 2 * pairs; ) {
+            double const s = play ( first_, second_, opening<State> ( options_.seed, g / 2, options_.opening_plies ), g % 2 == 0,
+                                    games ? &moves : nullptr );
+            std::lock_guard<std::mutex> lock ( mutex );
+            if ( games ) // the first engine is human in the even games.
+                games->append ( moves, 0.5 == s                      ? Player{ Player::Type::vacant }
+                                       : ( 1.0 == s ) == ( g % 2 == 0 ) ? Player{ Player::Type::human }
+                                                                        : Player{ Player::Type::agent } );
+            if ( stop.load ( std::memory_order_relaxed ) )
+                return;
+            // The score is only updated per pair, to not bias it by the order in which
+            // the games finish.
+            if ( pair_scores[ g / 2 ] < 0.0 ) {
+                pair_scores[ g / 2 ] = s;
+                continue;
+            }
+            for ( double const p : { pair_scores[ g / 2 ], s } )
+                ( 1.0 == p ? result.score.wins : 0.0 == p ? result.score.losses : result.score.draws ) += 1;
+            result.llr = result.score.llr ( options_.elo0, options_.elo1 );
+            if ( result.llr >= result.upper )
+                result.decision = Result::Decision::h1;
+            else if ( result.llr <= result.lower )
+                result.decision = Result::Decision::h0;
+            if ( options_.verbose )
+                std::cout << first_.name << " vs " << second_.name << ": " << result << std::endl;
+            if ( options_.sprt and Result::Decision::none != result.decision )
+                stop.store ( true, std::memory_order_relaxed );
+        }
+    };
+    std::vector<std::thread> threads;
+    for ( int t = 1; t < options_.concurrency; ++t )
+        threads.emplace_back ( work );
+    work ( );
+    for ( auto & thread : threads )
+        thread.join ( );
+    result.seconds = std::chrono::duration<double> ( std::chrono::steady_clock::now ( ) - start ).count ( );
+    return result;
+}
+
+} // namespace Arena
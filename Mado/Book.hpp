@@ -0,0 +1,158 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// An opening book, the best moves (and their statistics) of the positions of the first
+// plies, found by deep searches (Mcts::build_book ( )). Equivalent (symmetric) positions
+// share an entry, keyed by canonicalZobrist ( ), its move is stored for the canonical
+// image. On disk the entries are in Eytzinger (breadth first search tree) order, so the
+// book is searched in place, memory mapped, without being parsed.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <memory>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+namespace Book {
+
+// | magic 8 | version 4 | radius 4 | entries 8 | reserved 40 |, followed by the entries.
+struct Header {
+    char magic[ 8 ]        = { 'M', 'A', 'D', 'O', 'B', 'O', 'K', '\0' };
+    std::uint32_t version  = 1u;
+    std::uint32_t radius   = 0u;
+    std::uint64_t entries  = 0u;
+    std::uint8_t reserved[ 40 ] = { };
+};
+
+static_assert ( sizeof ( Header ) == 64, "the entries have to start at a 64 byte boundary" );
+
+struct Entry {
+    std::uint64_t key    = 0u; // canonicalZobrist ( ).
+    std::uint32_t visits = 0u; // of the move, all (the maximum), iff the move is a proven win.
+    std::uint16_t move   = 0u; // the dense_index ( ), of the move in the canonical image.
+    std::uint16_t wins   = 0u; // the fraction of wins of the move, times 65535.
+
+    [[nodiscard]] float win_rate ( ) const noexcept { return static_cast<float> ( wins ) / 65535.0f; }
+};
+
+static_assert ( sizeof ( Entry ) == 16, "4 entries per cache line" );
+
+// Lays out the sorted entries [ b_, e_ ) in Eytzinger order, k_ is 1-based.
+inline Entry const * eytzinger ( Entry const * b_, Entry const * const e_, std::vector<Entry> & out_, std::size_t const k_ = 1u ) {
+    if ( k_ <= out_.size ( ) ) {
+        b_              = eytzinger ( b_, e_, out_, 2u * k_ );
+        out_[ k_ - 1u ] = *b_++;
+        b_              = eytzinger ( b_, e_, out_, 2u * k_ + 1u );
+    }
+    return b_;
+}
+
+inline void save ( std::vector<Entry> entries_, int const radius_, std::filesystem::path const & path_ ) {
+    std::sort ( std::begin ( entries_ ), std::end ( entries_ ),
+                [] ( Entry const & a_, Entry const & b_ ) noexcept { return a_.key < b_.key; } );
+    entries_.erase ( std::unique ( std::begin ( entries_ ), std::end ( entries_ ),
+                                   [] ( Entry const & a_, Entry const & b_ ) noexcept { return a_.key == b_.key; } ),
+                     std::end ( entries_ ) );
+    std::vector<Entry> layout ( entries_.size ( ) );
+    eytzinger ( entries_.data ( ), entries_.data ( ) + entries_.size ( ), layout );
+    std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+    if ( not ostream )
+        throw std::runtime_error ( "Book: cannot write " + path_.string ( ) );
+    Header header;
+    header.radius  = static_cast<std::uint32_t> ( radius_ );
+    header.entries = layout.size ( );
+    ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+    ostream.write ( reinterpret_cast<char const *> ( layout.data ( ) ),
+                    static_cast<std::streamsize> ( layout.size ( ) * sizeof ( Entry ) ) );
+}
+
+// The (memory mapped) book.
+class Probe {
+
+    public:
+    explicit Probe ( std::filesystem::path const & path_ ) : m_file ( path_ ) {
+        Header header, expected;
+        if ( m_file.size ( ) < sizeof ( Header ) )
+            throw std::runtime_error ( "Book: not a book " + path_.string ( ) );
+        std::memcpy ( &header, m_file.data ( ), sizeof ( Header ) );
+        if ( std::memcmp ( header.magic, expected.magic, sizeof ( header.magic ) ) or expected.version != header.version or
+             m_file.size ( ) < sizeof ( Header ) + header.entries * sizeof ( Entry ) )
+            throw std::runtime_error ( "Book: wrong book " + path_.string ( ) );
+        m_radius  = static_cast<int> ( header.radius );
+        m_size    = static_cast<std::size_t> ( header.entries );
+        m_entries = reinterpret_cast<Entry const *> ( m_file.data ( ) + sizeof ( Header ) );
+    }
+
+    // The descent is branch-free, the next level of the tree is adjacent in memory.
+    [[nodiscard]] Entry const * find ( std::uint64_t const key_ ) const noexcept {
+        std::size_t k = 1u;
+        while ( k <= m_size )
+            k = 2u * k + ( m_entries[ k - 1u ].key < key_ );
+        while ( k & 1u ) // Undo the right turns, and the last left turn.
+            k >>= 1;
+        k >>= 1;
+        return k and m_entries[ k - 1u ].key == key_ ? m_entries + ( k - 1u ) : nullptr;
+    }
+
+    // The book move in state_, or no_move, iff the position is not in the book (or the
+    // book is of another board).
+    template<typename State>
+    [[nodiscard]] typename State::Move probe ( State const & state_ ) const noexcept {
+        if ( State::Board::radius ( ) != m_radius or state_.terminal ( ) )
+            return State::no_move;
+        int symmetry          = 0;
+        Entry const * const e = find ( state_.canonicalZobrist ( symmetry ) );
+        if ( not e )
+            return State::no_move;
+        auto const book_move = State::Move::from_dense_index ( e->move );
+        for ( auto const move : state_.availableMoves ( ) )
+            if ( State::transform ( move, symmetry ) == book_move )
+                return move;
+        return State::no_move;
+    }
+
+    [[nodiscard]] std::size_t size ( ) const noexcept { return m_size; }
+
+    private:
+    MappedFile m_file;
+    Entry const * m_entries = nullptr;
+    std::size_t m_size      = 0u;
+    int m_radius            = 0;
+};
+
+// The book at path_, or nullptr, iff there is none (playing without a book).
+[[nodiscard]] inline std::unique_ptr<Probe const> open ( std::filesystem::path const & path_ ) {
+    return std::filesystem::exists ( path_ ) ? std::make_unique<Probe const> ( path_ ) : nullptr;
+}
+
+} // namespace Book
@@ -0,0 +1,193 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A zero-copy reader of the records of a segment log (Segment::Log), for training. The
+// segments are memory mapped, and the records are used in place (they were written as
+// they are in memory), nothing is deserialized. The records are visited in a shuffled
+// order by a number of threads, the order is a pseudo-random permutation (a Feistel
+// network, cycle walking to the number of records), so it takes no memory, and is the
+// same for the same seed.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+#include "MappedFile.hpp"
+#include "SegmentLog.hpp"
+
+#if defined( _MSC_VER )
+#    include <intrin.h>
+#endif
+
+namespace Dataset {
+
+// A pseudo-random permutation of [ 0, size_ ), bijective.
+class Permutation {
+
+    public:
+    Permutation ( std::uint64_t const size_, std::uint64_t seed_ ) noexcept : m_size ( size_ ) {
+        while ( ( std::uint64_t{ 1 } << ( 2 * m_half_bits ) ) < m_size )
+            ++m_half_bits;
+        for ( auto & k : m_keys )
+            k = mix ( seed_ += 0x9e3779b97f4a7c15 );
+    }
+
+    [[nodiscard]] std::uint64_t operator( ) ( std::uint64_t i_ ) const noexcept {
+        do // At most 4 times the size, less than 4 rounds on average.
+            i_ = encrypt ( i_ );
+        while ( i_ >= m_size );
+        return i_;
+    }
+
+    private:
+    [[nodiscard]] static constexpr std::uint64_t mix ( std::uint64_t k ) noexcept {
+        k = ( k ^ ( k >> 30 ) ) * std::uint64_t{ 0xbf58476d1ce4e5b9 };
+        k = ( k ^ ( k >> 27 ) ) * std::uint64_t{ 0x94d049bb133111eb };
+        return k ^ ( k >> 31 );
+    }
+
+    [[nodiscard]] std::uint64_t encrypt ( std::uint64_t const i_ ) const noexcept {
+        std::uint64_t const mask = ( std::uint64_t{ 1 } << m_half_bits ) - 1u;
+        std::uint64_t l = i_ >> m_half_bits, r = i_ & mask;
+        for ( auto const k : m_keys ) {
+            std::uint64_t const t = l ^ ( mix ( r ^ k ) & mask );
+            l                     = r;
+            r                     = t;
+        }
+        return l << m_half_bits | r;
+    }
+
+    std::uint64_t m_size;
+    int m_half_bits = 1;
+    std::uint64_t m_keys[ 4 ];
+};
+
+template<typename Record>
+class Reader {
+
+    static_assert ( std::is_trivially_copyable<Record>::value and 64u % alignof ( Record ) == 0u,
+                    "records are used in place, after the 64 byte header of a segment" );
+
+    public:
+    struct Span {
+        Record const * data;
+        std::size_t size;
+
+        [[nodiscard]] Record const * begin ( ) const noexcept { return data; }
+        [[nodiscard]] Record const * end ( ) const noexcept { return data + size; }
+    };
+
+    // Maps the indexed segments of the log in directory_.
+    explicit Reader ( std::filesystem::path const & directory_ ) {
+        for ( auto const & e : Segment::read_index ( directory_ ) ) {
+            std::filesystem::path const path = Segment::segment_path ( directory_, e.segment );
+            MappedFile file ( path );
+            Segment::Header header, expected;
+            if ( file.size ( ) < sizeof ( Segment::Header ) )
+                throw std::runtime_error ( "Dataset: not a segment " + path.string ( ) );
+            std::memcpy ( &header, file.data ( ), sizeof ( Segment::Header ) );
+            if ( std::memcmp ( header.magic, expected.magic, sizeof ( header.magic ) ) or expected.version != header.version or
+                 sizeof ( Record ) != header.record_size )
+                throw std::runtime_error ( "Dataset: wrong segment " + path.string ( ) );
+            if ( file.size ( ) < sizeof ( Segment::Header ) + e.records * sizeof ( Record ) )
+                throw std::runtime_error ( "Dataset: truncated segment " + path.string ( ) );
+            m_spans.push_back ( { reinterpret_cast<Record const *> ( file.data ( ) + sizeof ( Segment::Header ) ),
+                                  static_cast<std::size_t> ( e.records ) } );
+            m_files.push_back ( std::move ( file ) );
+            m_first.push_back ( m_size );
+            m_size += e.records;
+        }
+    }
+
+    [[nodiscard]] std::uint64_t size ( ) const noexcept { return m_size; }
+    // The records, a span per segment.
+    [[nodiscard]] std::vector<Span> const & spans ( ) const noexcept { return m_spans; }
+
+    [[nodiscard]] Record const & operator[] ( std::uint64_t const i_ ) const noexcept {
+        std::size_t const s = static_cast<std::size_t> (
+            std::upper_bound ( std::begin ( m_first ), std::end ( m_first ), i_ ) - std::begin ( m_first ) - 1 );
+        return m_spans[ s ].data[ i_ - m_first[ s ] ];
+    }
+
+    void advise ( MappedFile::Access const access_ ) const noexcept {
+        for ( auto const & file : m_files )
+            file.advise ( access_ );
+    }
+
+    static void prefetch ( Record const & record_ ) noexcept {
+#if defined( _MSC_VER )
+        _mm_prefetch ( reinterpret_cast<char const *> ( &record_ ), _MM_HINT_T0 );
+#else
+        __builtin_prefetch ( &record_ );
+#endif
+    }
+
+    // Calls f_ ( record, index ) for all records, in the shuffled order of seed_, from
+    // number_of_threads_ threads, the records some calls ahead are prefetched.
+    template<typename Function>
+    void for_each_shuffled ( Function && f_, std::uint64_t const seed_,
+                             int const number_of_threads_ = static_cast<int> ( std::thread::hardware_concurrency ( ) ) ) const {
+        Permutation const permutation ( m_size, seed_ );
+        std::atomic<std::uint64_t> next{ 0u };
+        auto work = [ & ] ( ) {
+            constexpr std::uint64_t chunk = 4'096u, ahead = 8u;
+            std::uint64_t indices[ ahead ];
+            for ( std::uint64_t b; ( b = next.fetch_add ( chunk, std::memory_order_relaxed ) ) < m_size; ) {
+                std::uint64_t const e = std::min ( b + chunk, m_size );
+                for ( std::uint64_t i = b; i < std::min ( b + ahead, e ); ++i )
+                    prefetch ( ( *this )[ indices[ i % ahead ] = permutation ( i ) ] );
+                for ( std::uint64_t i = b; i < e; ++i ) {
+                    std::uint64_t const index = indices[ i % ahead ];
+                    if ( i + ahead < e )
+                        prefetch ( ( *this )[ indices[ i % ahead ] = permutation ( i + ahead ) ] );
+                    f_ ( ( *this )[ index ], index );
+                }
+            }
+        };
+        std::vector<std::thread> threads;
+        for ( int t = 1; t < number_of_threads_; ++t )
+            threads.emplace_back ( work );
+        work ( );
+        for ( auto & thread : threads )
+            thread.join ( );
+    }
+
+    private:
+    std::vector<MappedFile> m_files;
+    std::vector<Span> m_spans;
+    std::vector<std::uint64_t> m_first; // the index of the first record of every segment.
+    std::uint64_t m_size = 0u;
+};
+
+} // namespace Dataset
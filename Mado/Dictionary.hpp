@@ -0,0 +1,203 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A compression dictionary (for LZ4, of which only the last 64 KiB count), and its
+// trainer. The trainer builds the dictionary from the segments of the samples that
+// contain the most frequent d-mers (byte strings of length d), one segment per epoch
+// (a slice of the samples), as COVER (zstd) does. The most valuable segments go at the
+// end of the dictionary, closest to the data.
+//
+// The file is | magic 8 | version 4 | record size 4 | size 8 | id 8 | tag 4 | reserved 28 |,
+// followed by the dictionary. A file without the header is read as a raw dictionary.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "SegmentLog.hpp"
+
+namespace Archive {
+
+struct DictionaryHeader {
+    char magic[ 8 ]           = { 'M', 'A', 'D', 'O', 'D', 'I', 'C', '\0' };
+    std::uint32_t version     = 1u;
+    std::uint32_t record_size = 0u; // of the records it was trained on, 0 for any.
+    std::uint64_t size        = 0u;
+    std::uint64_t id          = 0u;
+    std::uint32_t tag         = 0u; // the version of the contents.
+    std::uint8_t reserved[ 28 ] = { };
+};
+
+static_assert ( sizeof ( DictionaryHeader ) == 64, "the dictionary has to start at a 64 byte boundary" );
+
+class Dictionary {
+
+    public:
+    Dictionary ( ) noexcept = default;
+    explicit Dictionary ( std::vector<char> bytes_, std::uint32_t const record_size_ = 0u, std::uint32_t const tag_ = 0u ) :
+        m_bytes ( std::move ( bytes_ ) ), m_record_size ( record_size_ ), m_tag ( tag_ ) {
+        if ( m_bytes.size ( ) > max_size )
+            m_bytes.erase ( std::begin ( m_bytes ), std::end ( m_bytes ) - max_size );
+        m_id = 0xcbf29ce484222325; // FNV-1a.
+        for ( char const c : m_bytes )
+            m_id = ( m_id ^ static_cast<std::uint8_t> ( c ) ) * std::uint64_t{ 0x100000001b3 };
+    }
+
+    [[nodiscard]] static Dictionary load ( std::filesystem::path const & path_ ) {
+        std::ifstream istream ( path_, std::ios::binary );
+        if ( not istream )
+            throw std::runtime_error ( "Archive: cannot read " + path_.string ( ) );
+        std::vector<char> bytes{ std::istreambuf_iterator<char> ( istream ), std::istreambuf_iterator<char> ( ) };
+        DictionaryHeader header, expected;
+        if ( bytes.size ( ) < sizeof ( DictionaryHeader ) or
+             std::memcmp ( bytes.data ( ), expected.magic, sizeof ( expected.magic ) ) )
+            return Dictionary ( std::move ( bytes ) );
+        std::memcpy ( &header, bytes.data ( ), sizeof ( DictionaryHeader ) );
+        if ( expected.version != header.version or bytes.size ( ) != sizeof ( DictionaryHeader ) + header.size )
+            throw std::runtime_error ( "Archive: wrong dictionary " + path_.string ( ) );
+        bytes.erase ( std::begin ( bytes ), std::begin ( bytes ) + sizeof ( DictionaryHeader ) );
+        Dictionary dictionary ( std::move ( bytes ), header.record_size, header.tag );
+        if ( dictionary.id ( ) != header.id )
+            throw std::runtime_error ( "Archive: corrupt dictionary " + path_.string ( ) );
+        return dictionary;
+    }
+
+    void save ( std::filesystem::path const & path_ ) const {
+        std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+        if ( not ostream )
+            throw std::runtime_error ( "Archive: cannot write " + path_.string ( ) );
+        DictionaryHeader header;
+        header.record_size = m_record_size;
+        header.size        = m_bytes.size ( );
+        header.id          = m_id;
+        header.tag         = m_tag;
+        ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( DictionaryHeader ) );
+        ostream.write ( m_bytes.data ( ), static_cast<std::streamsize> ( m_bytes.size ( ) ) );
+    }
+
+    [[nodiscard]] char const * data ( ) const noexcept { return m_bytes.data ( ); }
+    [[nodiscard]] int size ( ) const noexcept { return static_cast<int> ( m_bytes.size ( ) ); }
+    // Identifies the dictionary, an archive can only be read with the dictionary it was written with.
+    [[nodiscard]] std::uint64_t id ( ) const noexcept { return m_id; }
+    [[nodiscard]] std::uint32_t record_size ( ) const noexcept { return m_record_size; }
+    [[nodiscard]] std::uint32_t tag ( ) const noexcept { return m_tag; }
+
+    static constexpr std::size_t max_size = std::size_t{ 1 } << 16;
+
+    private:
+    std::vector<char> m_bytes;
+    std::uint64_t m_id          = 0xcbf29ce484222325;
+    std::uint32_t m_record_size = 0u, m_tag = 0u;
+};
+
+struct TrainOptions {
+    std::size_t size = Dictionary::max_size;
+    std::size_t k    = 64u; // the length of a segment.
+    std::size_t d    = 8u; // the length of a d-mer, at most 8.
+    int f            = 20; // log2 of the number of d-mer counters.
+};
+
+// Trains a dictionary on the samples_ (concatenated, of sizes_ bytes each).
+[[nodiscard]] inline std::vector<char> train ( std::vector<char> const & samples_, std::vector<std::size_t> const & sizes_,
+                                               TrainOptions const & options_ = TrainOptions{ } ) {
+    std::size_t const d = std::clamp ( options_.d, std::size_t{ 4 }, std::size_t{ 8 } ), k = std::max ( options_.k, d );
+    std::uint64_t const mask = d == 8u ? ~std::uint64_t{ 0 } : ( std::uint64_t{ 1 } << ( 8u * d ) ) - 1u;
+    std::vector<char> data;
+    data.reserve ( samples_.size ( ) + 8u );
+    data.insert ( std::end ( data ), std::begin ( samples_ ), std::end ( samples_ ) );
+    data.resize ( samples_.size ( ) + 8u ); // d-mers are read 8 bytes at a time.
+    // Whether a d-mer starts at i, i.e. does not cross the end of a sample.
+    std::vector<bool> starts ( samples_.size ( ), false );
+    for ( std::size_t b = 0u, i = 0u; i < sizes_.size ( ) and b < samples_.size ( ); b += sizes_[ i++ ] )
+        for ( std::size_t j = b; j + d <= std::min ( b + sizes_[ i ], samples_.size ( ) ); ++j )
+            starts[ j ] = true;
+    auto hash = [ & ] ( std::size_t const i_ ) noexcept -> std::size_t {
+        std::uint64_t v;
+        std::memcpy ( &v, data.data ( ) + i_, sizeof ( v ) );
+        return static_cast<std::size_t> ( ( ( v & mask ) * std::uint64_t{ 0x9e3779b97f4a7c15 } ) >> ( 64 - options_.f ) );
+    };
+    std::vector<std::uint32_t> frequency ( std::size_t{ 1 } << options_.f, 0u );
+    for ( std::size_t i = 0u; i < samples_.size ( ); ++i )
+        if ( starts[ i ] )
+            ++frequency[ hash ( i ) ];
+    // One segment per epoch, the one with the largest sum of the frequencies of its
+    // (distinct) d-mers, the d-mers taken are not counted again.
+    std::size_t const epochs = std::max<std::size_t> ( 1u, std::min ( options_.size / k, samples_.size ( ) / k ) );
+    std::size_t const epoch  = samples_.size ( ) / epochs;
+    std::vector<char> dictionary ( options_.size );
+    std::size_t tail = options_.size;
+    std::vector<std::uint16_t> active ( frequency.size ( ), 0u );
+    for ( std::size_t e = 0u; e < epochs and tail >= k; ++e ) {
+        std::size_t const begin = e * epoch, end = std::min ( begin + epoch, samples_.size ( ) );
+        std::uint64_t score = 0u, best_score = 0u;
+        std::size_t best = begin;
+        for ( std::size_t i = begin; i < end; ++i ) {
+            if ( starts[ i ] and not active[ hash ( i ) ]++ )
+                score += frequency[ hash ( i ) ];
+            if ( i >= begin + k - d + 1u ) { // The d-mer at i - ( k - d + 1 ) leaves the segment.
+                std::size_t const j = i - ( k - d + 1u );
+                if ( starts[ j ] and not --active[ hash ( j ) ] )
+                    score -= frequency[ hash ( j ) ];
+            }
+            if ( score > best_score ) {
+                best_score = score;
+                best       = i + d > begin + k ? i + d - k : begin;
+            }
+        }
+        for ( std::size_t j = end - begin > k - d + 1u ? end - ( k - d + 1u ) : begin; j < end; ++j ) // Clear the window.
+            if ( starts[ j ] )
+                active[ hash ( j ) ] = 0u;
+        if ( not best_score )
+            continue;
+        for ( std::size_t j = best; j + d <= best + k; ++j )
+            if ( starts[ j ] )
+                frequency[ hash ( j ) ] = 0u;
+        tail -= k;
+        std::memcpy ( dictionary.data ( ) + tail, data.data ( ) + best, k );
+    }
+    dictionary.erase ( std::begin ( dictionary ), std::begin ( dictionary ) + static_cast<std::ptrdiff_t> ( tail ) );
+    return dictionary;
+}
+
+// Trains a dictionary on a sample of the records of the segment log in directory_.
+template<typename Record>
+[[nodiscard]] Dictionary train ( std::filesystem::path const & directory_, std::size_t const samples_ = 100'000u,
+                                 TrainOptions const & options_ = TrainOptions{ }, std::uint32_t const tag_ = 1u ) {
+    std::vector<Record> const records = Segment::sample<Record> ( directory_, samples_ );
+    std::vector<char> bytes ( records.size ( ) * sizeof ( Record ) );
+    std::memcpy ( bytes.data ( ), records.data ( ), bytes.size ( ) );
+    return Dictionary ( train ( bytes, std::vector<std::size_t> ( records.size ( ), sizeof ( Record ) ), options_ ),
+                        static_cast<std::uint32_t> ( sizeof ( Record ) ), tag_ );
+}
+
+} // namespace Archive
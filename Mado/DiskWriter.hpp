@@ -0,0 +1,304 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A writer of files on a thread of its own, so the threads that produce the data (the
+// search threads) never wait for the disk. The bytes of the calls of all threads are
+// copied into a batch, in order, the writer thread takes the whole batch at a time, and
+// writes the consecutive requests for the same file in one go (large sequential appends).
+// The files appended to are kept open (a few, the least recently used is closed), a file
+// that is replaced is closed after it is written. Only the calls of sync ( ) are durability points, up to there
+// everything is written, and flushed to the device. A producer only waits iff the writer
+// is behind by more than the maximum of pending bytes.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <condition_variable>
+#include <exception>
+#include <filesystem>
+#include <future>
+#include <mutex>
+#include <set>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <system_error>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#if defined( _WIN32 )
+#    include <io.h>
+#else
+#    include <unistd.h>
+#endif
+
+namespace Io {
+
+struct Stats {
+    std::uint64_t requests = 0u, bytes = 0u, writes = 0u, syncs = 0u, errors = 0u;
+    std::size_t max_pending = 0u; // bytes queued, but not taken by the writer.
+};
+
+class DiskWriter {
+
+    public:
+    explicit DiskWriter ( std::size_t const max_pending_ = std::size_t{ 1 } << 28 ) :
+        m_max_pending ( max_pending_ ), m_writer ( [ this ] ( ) { run ( ); } ) {}
+    DiskWriter ( DiskWriter const & ) = delete;
+    DiskWriter ( DiskWriter && )      = delete;
+
+    ~DiskWriter ( ) noexcept { close ( ); }
+
+    DiskWriter & operator= ( DiskWriter const & ) = delete;
+    DiskWriter & operator= ( DiskWriter && ) = delete;
+
+    // Appends (a copy of) the bytes to the file, in the order of the calls (of all threads).
+    void append ( std::filesystem::path const & path_, void const * const data_, std::size_t const size_ ) {
+        enqueue ( path_, data_, size_, Mode::append );
+    }
+    void append ( std::filesystem::path const & path_, std::string_view const bytes_ ) {
+        enqueue ( path_, bytes_.data ( ), bytes_.size ( ), Mode::append );
+    }
+
+    // Replaces the file by (a copy of) the bytes.
+    void write ( std::filesystem::path const & path_, void const * const data_, std::size_t const size_ ) {
+        enqueue ( path_, data_, size_, Mode::replace );
+    }
+    void write ( std::filesystem::path const & path_, std::string_view const bytes_ ) {
+        enqueue ( path_, bytes_.data ( ), bytes_.size ( ), Mode::replace );
+    }
+
+    // A durability point, the future is ready once all bytes queued before the call are
+    // written, and flushed to the device, and holds the first error since the previous
+    // durability point, if any.
+    [[nodiscard]] std::future<void> sync ( ) {
+        std::promise<void> promise;
+        std::future<void> future = promise.get_future ( );
+        {
+            std::lock_guard<std::mutex> lock ( m_mutex );
+            if ( m_stop ) // Nothing would fulfil the promise.
+                throw std::runtime_error ( "DiskWriter: closed, cannot sync" );
+            m_front.syncs.push_back ( std::move ( promise ) );
+        }
+        m_work.notify_one ( );
+        return future;
+    }
+
+    // Writes everything queued, and closes the files, the writer cannot be used after.
+    void close ( ) noexcept {
+        {
+            std::lock_guard<std::mutex> lock ( m_mutex );
+            m_stop = true;
+        }
+        m_work.notify_one ( );
+        if ( m_writer.joinable ( ) )
+            m_writer.join ( );
+    }
+
+    [[nodiscard]] Stats stats ( ) const {
+        std::lock_guard<std::mutex> lock ( m_mutex );
+        return m_stats;
+    }
+
+    private:
+    enum class Mode { append, replace };
+
+    struct Request {
+        std::filesystem::path path;
+        Mode mode;
+        std::size_t offset, size; // of the bytes in the batch.
+    };
+
+    struct Batch {
+        std::vector<char> bytes;
+        std::vector<Request> requests;
+        std::vector<std::promise<void>> syncs;
+
+        [[nodiscard]] bool empty ( ) const noexcept { return requests.empty ( ) and syncs.empty ( ); }
+        void clear ( ) noexcept {
+            bytes.clear ( );
+            requests.clear ( );
+            syncs.clear ( );
+        }
+    };
+
+    void enqueue ( std::filesystem::path const & path_, void const * const data_, std::size_t const size_, Mode const mode_ ) {
+        {
+            std::unique_lock<std::mutex> lock ( m_mutex );
+            if ( m_stop )
+                throw std::runtime_error ( "DiskWriter: closed, cannot write " + path_.string ( ) );
+            m_space.wait ( lock, [ & ] ( ) { return m_front.bytes.empty ( ) or m_front.bytes.size ( ) + size_ <= m_max_pending; } );
+            m_front.requests.push_back ( Request{ path_, mode_, m_front.bytes.size ( ), size_ } );
+            m_front.bytes.insert ( std::end ( m_front.bytes ), static_cast<char const *> ( data_ ),
+                                   static_cast<char const *> ( data_ ) + size_ );
+            m_stats.requests += 1u;
+            m_stats.bytes += size_;
+            m_stats.max_pending = std::max ( m_stats.max_pending, m_front.bytes.size ( ) );
+        }
+        m_work.notify_one ( );
+    }
+
+    [[nodiscard]] static std::FILE * open ( std::filesystem::path const & path_, Mode const mode_ ) noexcept {
+#if defined( _WIN32 )
+        return _wfopen ( path_.c_str ( ), Mode::append == mode_ ? L"ab" : L"wb" );
+#else
+        return std::fopen ( path_.c_str ( ), Mode::append == mode_ ? "ab" : "wb" );
+#endif
+    }
+
+    [[nodiscard]] static bool flush ( std::FILE * const file_, bool const durable_ ) noexcept {
+        if ( std::fflush ( file_ ) )
+            return false;
+        if ( not durable_ )
+            return true;
+#if defined( _WIN32 )
+        return not _commit ( _fileno ( file_ ) );
+#else
+        return not ::fsync ( ::fileno ( file_ ) );
+#endif
+    }
+
+    void run ( ) noexcept {
+        Batch batch;
+        std::vector<std::pair<std::filesystem::path, std::FILE *>> files; // appended to, the most recently used last.
+        std::set<std::filesystem::path> closed; // flushed, and closed, but not synced, since the last durability point.
+        std::exception_ptr error;               // the first, since the last durability point.
+        files.reserve ( max_open );
+        auto find = [ &files ] ( std::filesystem::path const & path_ ) noexcept {
+            return std::find_if ( std::begin ( files ), std::end ( files ),
+                                  [ &path_ ] ( auto const & f_ ) noexcept { return f_.first == path_; } );
+        };
+        for ( ;; ) {
+            {
+                std::unique_lock<std::mutex> lock ( m_mutex );
+                m_work.wait ( lock, [ this ] ( ) { return m_stop or not m_front.empty ( ); } );
+                if ( m_front.empty ( ) ) // Stopped.
+                    break;
+                std::swap ( batch, m_front );
+            }
+            m_space.notify_all ( );
+            bool const durable   = not batch.syncs.empty ( );
+            std::uint64_t writes = 0u, errors = 0u;
+            auto fail = [ & ] ( std::string const & what_ ) {
+                errors += 1u;
+                if ( not error )
+                    error = std::make_exception_ptr ( std::runtime_error ( "DiskWriter: " + what_ ) );
+            };
+            auto close = [ & ] ( std::filesystem::path const & path_, std::FILE * const file_ ) {
+                bool const flushed = flush ( file_, durable );
+                if ( std::fclose ( file_ ) or not flushed )
+                    fail ( "cannot flush " + path_.string ( ) );
+                if ( not durable )
+                    closed.insert ( path_ );
+            };
+            // The consecutive requests for the same file, appending, are written at once.
+            for ( std::size_t i = 0u, j; i < batch.requests.size ( ); i = j ) {
+                Request const & r = batch.requests[ i ];
+                std::size_t size  = r.size;
+                for ( j = i + 1u; j < batch.requests.size ( ) and batch.requests[ j ].path == r.path and
+                                  Mode::append == batch.requests[ j ].mode;
+                      ++j )
+                    size += batch.requests[ j ].size;
+                std::FILE * file = nullptr;
+                auto const f    = find ( r.path );
+                if ( std::end ( files ) != f ) {
+                    file = f->second;
+                    files.erase ( f );
+                    if ( Mode::replace == r.mode ) {
+                        close ( r.path, file );
+                        file = nullptr;
+                    }
+                }
+                if ( not file and not( file = open ( r.path, r.mode ) ) ) {
+                    fail ( "cannot open " + r.path.string ( ) );
+                    continue;
+                }
+                if ( std::fwrite ( batch.bytes.data ( ) + r.offset, 1u, size, file ) != size )
+                    fail ( "cannot write " + r.path.string ( ) );
+                writes += 1u;
+                if ( Mode::replace == r.mode ) {
+                    close ( r.path, file );
+                    continue;
+                }
+                if ( max_open == files.size ( ) ) {
+                    close ( files.front ( ).first, files.front ( ).second );
+                    files.erase ( std::begin ( files ) );
+                }
+                files.emplace_back ( r.path, file );
+            }
+            // The open files are flushed after every batch (so the bytes are visible to
+            // readers), and synced on a durability point.
+            for ( auto const & [ path, file ] : files )
+                if ( not flush ( file, durable ) )
+                    fail ( "cannot flush " + path.string ( ) );
+            // The files closed since the last durability point are reopened, and synced.
+            if ( durable ) {
+                for ( auto const & path : closed ) {
+                    std::error_code ec; // Open (and synced above), or gone.
+                    if ( std::end ( files ) != find ( path ) or not std::filesystem::exists ( path, ec ) )
+                        continue;
+                    std::FILE * const file = open ( path, Mode::append );
+                    if ( not file or not flush ( file, true ) )
+                        fail ( "cannot sync " + path.string ( ) );
+                    if ( file )
+                        std::fclose ( file );
+                }
+                closed.clear ( );
+            }
+            {
+                std::lock_guard<std::mutex> lock ( m_mutex );
+                m_stats.writes += writes;
+                m_stats.errors += errors;
+                m_stats.syncs += batch.syncs.size ( );
+            }
+            for ( auto & promise : batch.syncs )
+                if ( error )
+                    promise.set_exception ( error );
+                else
+                    promise.set_value ( );
+            if ( durable )
+                error = nullptr;
+            batch.clear ( ); // Keeps the capacity, for the next swap.
+        }
+        for ( auto const & f : files )
+            std::fclose ( f.second );
+    }
+
+    static constexpr std::size_t max_open = 16u; // files appended to, kept open.
+
+    std::size_t m_max_pending;
+    mutable std::mutex m_mutex;
+    std::condition_variable m_work, m_space;
+    Batch m_front; // filled by the producers.
+    Stats m_stats;
+    bool m_stop = false;
+    std::thread m_writer; // Last, started after all other members are constructed.
+};
+
+} // namespace Io
@@ -48,6 +48,7 @@
 
 #include "Globals.hpp"
 #include "Hexcontainer.hpp"
+#include "MonteCarlo.hpp"
 
 #include "resource.h"
 
@@ -322,6 +323,35 @@ struct PlayArea : public sf::Drawable, public sf::Transformable {
 
     PlayArea ( State & state_, GameClock & clock_, sf::Vector2f const center_, float hori_, float vert_, float circle_diameter_ );
 
+    // The opening book, iff there is one, a bad book is reported, and the agent plays without.
+    [[nodiscard]] static Book::Probe const * book ( ) noexcept {
+        static std::unique_ptr<Book::Probe const> const book = [ ] ( ) noexcept -> std::unique_ptr<Book::Probe const> {
+            try {
+                return Book::open ( g_app_data_path / "mado.book" );
+            }
+            catch ( std::exception const & e ) {
+                std::cerr << e.what ( ) << ", playing without a book" << nl;
+            }
+            catch ( ... ) {
+            }
+            return nullptr;
+        }( );
+        return book.get ( );
+    }
+
+    [[nodiscard]] static Mcts::ComputeOptions agent_options ( ) noexcept {
+        Mcts::ComputeOptions options;
+        options.number_of_threads    = std::max ( 1, static_cast<int> ( std::thread::hardware_concurrency ( ) ) - 1 );
+        options.max_time             = 5.0f;
+        options.max_memory           = std::size_t{ 1 } << 30;
+        options.solver_nodes         = 250'000;
+        options.threat_depth         = 4;
+        options.playout_threat_depth = 0;
+        options.verbose              = false;
+        options.book                 = book ( );
+        return options;
+    }
+
     ~PlayArea ( ) {
         // Wait for the agent to return it's Move. This
         // is the only time this lock might spin.
@@ -399,13 +429,14 @@ struct PlayArea : public sf::Drawable, public sf::Transformable {
             m_move_lock.lock ( );
             agent_is_making_move = true;
             m_move_future        = std::move ( stlab::async ( stlab::default_executor, [ & ] ( ) noexcept {
-                                            return m_state.randomMoveDelayed ( );
+                                            return m_ponder.compute_move ( m_state );
                                         } ).then ( [ & ] ( state_move m ) noexcept {
                 m_lock.lock ( );
                 m_agent_move = m;
                 m_lock.unlock ( );
                 m_state.moveHashWinner ( m );
                 m_clock.update_next ( );
+                m_ponder.start ( m_state ); // Think on the human's time.
                 agent_is_making_move = false;
                 m_move_lock.unlock ( );
             } ) );
@@ -525,6 +556,7 @@ struct PlayArea : public sf::Drawable, public sf::Transformable {
 
     state_reference m_state;
     clock_reference m_clock;
+    Mcts::Ponder<State> m_ponder;
 
     play_area_lock m_lock;
     stlab::future<void> m_move_future;
@@ -539,7 +571,7 @@ PlayArea<State>::PlayArea ( State & state_, GameClock & clock_, sf::Vector2f con
     // Parameters.
     m_hori{ hori_ },
     m_vert{ vert_ }, m_circle_diameter{ circle_diameter_ }, m_circle_radius{ std::floorf ( m_circle_diameter * 0.5f ) },
-    m_last{ not_set }, agent_is_making_move{ false }, m_state{ state_ }, m_clock{ clock_ } {
+    m_last{ not_set }, agent_is_making_move{ false }, m_state{ state_ }, m_clock{ clock_ }, m_ponder{ agent_options ( ) } {
     // Load play area graphics.
     sf::loadFromResource ( m_texture, CIRCLES_LARGE );
     m_texture.setSmooth ( true );
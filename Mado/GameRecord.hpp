@@ -0,0 +1,330 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Compact records of whole games, from the start position, from which the positions are
+// derived on demand (by replaying the moves), in stead of being stored. A placement is
+// coded in 1 byte (the cell), a slide in 2 (the cell, and the direction, the index of the
+// destination in the neighbors of the cell, 3 bits). A game is | length | winner | moves |,
+// the length (of the moves, in bytes) a varint.
+//
+// | header 64 | game 0 | game 1 | ... | index |, the index holds the offsets (from the start
+// of the file) of every index_stride-th game, and of the end of the last game.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "MappedFile.hpp"
+
+namespace Game {
+
+// | magic 8 | version 4 | radius 4 | games 8 | index 8 | index stride 8 | reserved 24 |.
+struct Header {
+    char magic[ 8 ]             = { 'M', 'A', 'D', 'O', 'G', 'A', 'M', '\0' };
+    std::uint32_t version       = 1u;
+    std::uint32_t radius        = 0u;
+    std::uint64_t games         = 0u;
+    std::uint64_t index         = 0u; // the offset of the index.
+    std::uint64_t index_stride  = 0u;
+    std::uint8_t reserved[ 24 ] = { };
+};
+
+static_assert ( sizeof ( Header ) == 64, "the header is 64 bytes" );
+
+inline constexpr std::uint64_t index_stride = 256u;
+
+template<typename State>
+void encode ( typename State::Move const move_, std::vector<std::uint8_t> & out_ ) {
+    using Board = typename State::Board;
+    static_assert ( Board::size ( ) <= 128, "a cell is coded in 7 bits" );
+    if ( move_.is_placement ( ) ) {
+        out_.push_back ( static_cast<std::uint8_t> ( move_.to ) );
+        return;
+    }
+    auto const & neighbors = Board::neighbors[ move_.from ];
+    out_.push_back ( static_cast<std::uint8_t> ( 0x80 | move_.from ) );
+    out_.push_back ( static_cast<std::uint8_t> ( std::find ( std::begin ( neighbors ), std::end ( neighbors ), move_.to ) -
+                                                 std::begin ( neighbors ) ) );
+}
+
+// Decodes the move at p_ (before end_), and advances p_ past it.
+template<typename State>
+[[nodiscard]] typename State::Move decode ( std::uint8_t const *& p_, std::uint8_t const * const end_ ) {
+    using Move    = typename State::Move;
+    using IdxType = typename State::IdxType;
+    using Board   = typename State::Board;
+    if ( p_ >= end_ or ( *p_ & 0x7f ) >= Board::size ( ) )
+        throw std::runtime_error ( "Game: corrupt move" );
+    std::uint8_t const c = *p_++;
+    if ( not( c & 0x80 ) )
+        return Move{ static_cast<IdxType> ( c ) };
+    auto const & neighbors = Board::neighbors[ c & 0x7f ];
+    if ( p_ >= end_ or *p_ >= neighbors.size ( ) )
+        throw std::runtime_error ( "Game: corrupt move" );
+    return Move{ static_cast<IdxType> ( c & 0x7f ), neighbors[ *p_++ ] };
+}
+
+inline void encode_varint ( std::uint64_t v_, std::vector<std::uint8_t> & out_ ) {
+    for ( ; v_ >= 0x80; v_ >>= 7 )
+        out_.push_back ( static_cast<std::uint8_t> ( v_ | 0x80 ) );
+    out_.push_back ( static_cast<std::uint8_t> ( v_ ) );
+}
+
+[[nodiscard]] inline std::uint64_t decode_varint ( std::uint8_t const *& p_, std::uint8_t const * const end_ ) {
+    std::uint64_t v = 0u;
+    for ( int shift = 0;; shift += 7 ) {
+        if ( p_ >= end_ or shift > 63 )
+            throw std::runtime_error ( "Game: corrupt length" );
+        std::uint8_t const c = *p_++;
+        v |= static_cast<std::uint64_t> ( c & 0x7f ) << shift;
+        if ( not( c & 0x80 ) )
+            return v;
+    }
+}
+
+template<typename State>
+class Writer {
+
+    public:
+    using Move   = typename State::Move;
+    using Player = typename State::value_type;
+
+    explicit Writer ( std::filesystem::path const & path_ ) :
+        m_path ( path_ ), m_ostream ( path_, std::ios::binary | std::ios::trunc ) {
+        if ( not m_ostream )
+            throw std::runtime_error ( "Game: cannot write " + path_.string ( ) );
+        Header header;
+        m_ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+        m_offset = sizeof ( Header );
+    }
+    Writer ( Writer const & ) = delete;
+    Writer ( Writer && )      = delete;
+
+    ~Writer ( ) noexcept {
+        try {
+            close ( );
+        }
+        catch ( ... ) {
+        }
+    }
+
+    Writer & operator= ( Writer const & ) = delete;
+    Writer & operator= ( Writer && ) = delete;
+
+    // The moves of a game from the start position, the winner is invalid if the game was
+    // not played out.
+    template<typename Moves>
+    void append ( Moves const & moves_, Player const winner_ ) {
+        m_moves.clear ( );
+        for ( Move const move : moves_ )
+            encode<State> ( move, m_moves );
+        m_game.clear ( );
+        encode_varint ( m_moves.size ( ), m_game );
+        m_game.push_back ( static_cast<std::uint8_t> ( winner_.as_index ( ) ) );
+        m_game.insert ( std::end ( m_game ), std::begin ( m_moves ), std::end ( m_moves ) );
+        if ( 0u == m_games++ % index_stride )
+            m_index.push_back ( m_offset );
+        m_ostream.write ( reinterpret_cast<char const *> ( m_game.data ( ) ), static_cast<std::streamsize> ( m_game.size ( ) ) );
+        m_offset += m_game.size ( );
+    }
+
+    // Writes the index and the header.
+    void close ( ) {
+        if ( not m_ostream.is_open ( ) )
+            return;
+        Header header;
+        header.radius       = static_cast<std::uint32_t> ( State::Hex::radius ( ) );
+        header.games        = m_games;
+        header.index        = m_offset;
+        header.index_stride = index_stride;
+        m_index.push_back ( m_offset );
+        m_ostream.write ( reinterpret_cast<char const *> ( m_index.data ( ) ),
+                          static_cast<std::streamsize> ( m_index.size ( ) * sizeof ( std::uint64_t ) ) );
+        m_ostream.seekp ( 0 );
+        m_ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+        m_ostream.close ( );
+        if ( not m_ostream )
+            throw std::runtime_error ( "Game: cannot write " + m_path.string ( ) );
+    }
+
+    [[nodiscard]] std::uint64_t games ( ) const noexcept { return m_games; }
+
+    private:
+    std::filesystem::path m_path;
+    std::ofstream m_ostream;
+    std::vector<std::uint8_t> m_moves, m_game;
+    std::vector<std::uint64_t> m_index;
+    std::uint64_t m_games = 0u, m_offset = 0u;
+};
+
+template<typename State>
+class Reader {
+
+    public:
+    using Move   = typename State::Move;
+    using Player = typename State::value_type;
+
+    // A game, as it is in the file.
+    struct Record {
+        std::uint8_t const * begin; // the moves.
+        std::uint8_t const * end;
+        Player winner;
+
+        [[nodiscard]] std::vector<Move> moves ( ) const {
+            std::vector<Move> moves;
+            for ( std::uint8_t const * p = begin; p < end; )
+                moves.push_back ( decode<State> ( p, end ) );
+            return moves;
+        }
+    };
+
+    explicit Reader ( std::filesystem::path const & path_ ) : m_file ( path_ ) {
+        Header expected;
+        if ( m_file.size ( ) < sizeof ( Header ) )
+            throw std::runtime_error ( "Game: not a game file " + path_.string ( ) );
+        std::memcpy ( &m_header, m_file.data ( ), sizeof ( Header ) );
+        if ( std::memcmp ( m_header.magic, expected.magic, sizeof ( m_header.magic ) ) or expected.version != m_header.version or
+             State::Hex::radius ( ) != static_cast<int> ( m_header.radius ) or 0u == m_header.index_stride )
+            throw std::runtime_error ( "Game: wrong game file " + path_.string ( ) );
+        if ( m_file.size ( ) < m_header.index or ( m_file.size ( ) - m_header.index ) / sizeof ( std::uint64_t ) < index_size ( ) )
+            throw std::runtime_error ( "Game: truncated game file " + path_.string ( ) );
+        // The index is copied (it is not aligned), and checked, the games of stride i are in
+        // [ index[ i ], index[ i + 1 ] ), and the last ends at the index.
+        m_index.resize ( static_cast<std::size_t> ( index_size ( ) ) );
+        std::memcpy ( m_index.data ( ), m_file.data ( ) + m_header.index, m_index.size ( ) * sizeof ( std::uint64_t ) );
+        if ( sizeof ( Header ) != m_index.front ( ) or m_header.index != m_index.back ( ) or
+             not std::is_sorted ( std::begin ( m_index ), std::end ( m_index ) ) )
+            throw std::runtime_error ( "Game: corrupt index of " + path_.string ( ) );
+    }
+
+    [[nodiscard]] std::uint64_t size ( ) const noexcept { return m_header.games; }
+
+    // The i_-th game, skipping from the nearest indexed game.
+    [[nodiscard]] Record operator[] ( std::uint64_t const i_ ) const {
+        if ( i_ >= size ( ) )
+            throw std::runtime_error ( "Game: no game " + std::to_string ( i_ ) );
+        std::uint64_t const s  = i_ / m_header.index_stride;
+        std::uint8_t const * p = m_file.data ( ) + m_index[ s ];
+        Record record;
+        for ( std::uint64_t g = i_ - i_ % m_header.index_stride; g <= i_; ++g )
+            record = next ( p, m_file.data ( ) + m_index[ s + 1u ] );
+        return record;
+    }
+
+    // Calls f_ ( game, record ) for the games [ first_, last_ ).
+    template<typename Function>
+    void for_each ( Function && f_, std::uint64_t const first_, std::uint64_t last_ ) const {
+        last_ = std::min ( last_, size ( ) );
+        if ( first_ >= last_ )
+            return;
+        std::uint8_t const * p = m_file.data ( ) + m_index[ first_ / m_header.index_stride ];
+        for ( std::uint64_t g = first_ - first_ % m_header.index_stride; g < last_; ++g ) {
+            Record const record = next ( p, m_file.data ( ) + m_index[ g / m_header.index_stride + 1u ] );
+            if ( g >= first_ )
+                f_ ( g, record );
+        }
+    }
+
+    // Replays the games [ first_, last_ ), calls f_ ( game, state ) after every move.
+    template<typename Function>
+    void replay ( Function && f_, std::uint64_t const first_, std::uint64_t const last_ ) const {
+        State state;
+        for_each (
+            [ & ] ( std::uint64_t const game_, Record const & record_ ) {
+                state.reset ( );
+                for ( std::uint8_t const * p = record_.begin; p < record_.end; ) {
+                    state.moveHashWinner ( decode<State> ( p, record_.end ) );
+                    f_ ( game_, state );
+                }
+            },
+            first_, last_ );
+    }
+
+    // Replays all games, from number_of_threads_ threads, an index stride of games at a time.
+    template<typename Function>
+    void replay ( Function && f_,
+                  int const number_of_threads_ = static_cast<int> ( std::thread::hardware_concurrency ( ) ) ) const {
+        std::atomic<std::uint64_t> next{ 0u };
+        std::mutex mutex;
+        std::exception_ptr error; // the first, rethrown after all threads are done.
+        auto work = [ & ] ( ) {
+            try {
+                for ( std::uint64_t g; ( g = next.fetch_add ( m_header.index_stride, std::memory_order_relaxed ) ) < size ( ); )
+                    replay ( f_, g, std::min ( g + m_header.index_stride, size ( ) ) );
+            }
+            catch ( ... ) {
+                next.store ( size ( ), std::memory_order_relaxed ); // Stops the other threads.
+                std::lock_guard<std::mutex> lock ( mutex );
+                if ( not error )
+                    error = std::current_exception ( );
+            }
+        };
+        std::vector<std::thread> threads;
+        for ( int t = 1; t < number_of_threads_; ++t )
+            threads.emplace_back ( work );
+        work ( );
+        for ( auto & thread : threads )
+            thread.join ( );
+        if ( error )
+            std::rethrow_exception ( error );
+    }
+
+    private:
+    [[nodiscard]] std::uint64_t index_size ( ) const noexcept {
+        return m_header.games / m_header.index_stride + ( m_header.games % m_header.index_stride ? 2u : 1u );
+    }
+
+    // The game at p_ (before end_, the end of its stride), advances p_ past it.
+    [[nodiscard]] static Record next ( std::uint8_t const *& p_, std::uint8_t const * const end_ ) {
+        std::uint64_t const length = decode_varint ( p_, end_ );
+        if ( p_ >= end_ or static_cast<std::uint64_t> ( end_ - p_ - 1 ) < length )
+            throw std::runtime_error ( "Game: corrupt game" );
+        std::int8_t const winner = static_cast<std::int8_t> ( *p_++ );
+        if ( winner < -2 or winner > 1 )
+            throw std::runtime_error ( "Game: corrupt winner" );
+        Record record;
+        record.winner = Player{ static_cast<typename Player::Type> ( winner ) };
+        record.begin  = p_;
+        record.end    = p_ += length;
+        return record;
+    }
+
+    MappedFile m_file;
+    Header m_header;
+    std::vector<std::uint64_t> m_index;
+};
+
+} // namespace Game
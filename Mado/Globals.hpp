@@ -33,6 +33,7 @@
 #include <limits>
 #include <numeric>
 #include <random>
+#include <sstream>
 
 #include <SFML/Extensions.hpp>
 
@@ -40,6 +41,8 @@
 #include <sax/singleton.hpp>
 #include <sax/uniform_int_distribution.hpp>
 
+#include "DiskWriter.hpp"
+
 // C++ global constants have static linkage. This is different from C.
 // If you try to use a global constant in C++ in multiple files you get
 // an unresolved external error. The compiler optimizes global constants
@@ -118,24 +121,27 @@ extern fs::path const & g_app_path;
 using Window   = sax::singleton<sf::RenderWindow>;
 using Clock    = sax::singleton<sf::HrClock>;
 using Animator = sax::singleton<sf::CallbackAnimator>;
+using Disk     = sax::singleton<Io::DiskWriter>;
 
 [[nodiscard]] inline sf::HrClock::duration since ( sf::HrTimePoint const start_ ) noexcept {
     return ( Clock::instance ( ).now ( ) - start_ );
 }
 
+// The file is written by the disk writer (in the background).
 template<typename T>
 void saveToFile ( T const & t_, fs::path const & path_, std::string const & file_name_ ) {
-    std::ofstream ostream ( path_ / ( file_name_ + std::string ( ".txt" ) ), std::ios::out );
+    std::ostringstream ostream ( std::ios::out );
     {
         cereal::CSVOutputArchive archive ( ostream );
         archive ( t_ );
     }
     ostream << std::endl;
-    ostream.close ( );
+    Disk::instance ( ).write ( path_ / ( file_name_ + std::string ( ".txt" ) ), ostream.str ( ) );
 }
 
 template<typename T>
 void loadFromFile ( T & t_, fs::path const & path_, std::string const & file_name_ ) {
+    Disk::instance ( ).sync ( ).wait ( ); // The pending writes first.
     std::ifstream istream ( path_ / ( file_name_ + std::string ( ".txt" ) ), std::ios::in );
     {
         cereal::CSVInputArchive archive ( istream );
@@ -179,6 +179,11 @@ struct HexBase : public RadiusBase<R, zero_base> {
     using neighbors_type       = std::experimental::fixed_capacity_vector<IdxType, 6>;
     using neighbors_type_array = std::array<neighbors_type, rad::size ( )>;
 
+    // The 12 symmetries of the hexagon (6 rotations, each optionally preceded by a
+    // reflection), as permutations of the indices, element 0 is the identity.
+    using symmetry_type       = std::array<IdxType, rad::size ( )>;
+    using symmetry_type_array = std::array<symmetry_type, 12>;
+
     using const_iterator = typename neighbors_type::const_iterator;
 
     using rad::center_idx;
@@ -241,8 +246,37 @@ struct HexBase : public RadiusBase<R, zero_base> {
         return na;
     }
 
+    [[nodiscard]] static constexpr symmetry_type_array const make_symmetries_array ( ) noexcept {
+        symmetry_type_array sa{ };
+        size_type const c = center_idx ( );
+        for ( size_type q = c - radius ( ); q <= c + radius ( ); ++q ) {
+            for ( size_type r = c - radius ( ); r <= c + radius ( ); ++r ) {
+                if ( is_invalid ( q, r ) )
+                    continue;
+                size_type const i = index ( q, r );
+                // Cube coordinates, relative to the center.
+                size_type x = q - c, z = r - c, y = -x - z;
+                for ( size_type s = 0; s < 12; ++s ) {
+                    if ( 6 == s ) { // Reflect, swaps the r- and s-axes.
+                        size_type const t = y;
+                        y                 = z;
+                        z                 = t;
+                    }
+                    sa[ s ][ i ] = static_cast<IdxType> ( index ( x + c, z + c ) );
+                    // Rotate 60 degrees.
+                    size_type const t = x;
+                    x                 = -z;
+                    z                 = -y;
+                    y                 = -t;
+                }
+            }
+        }
+        return sa;
+    }
+
     public:
     static constexpr neighbors_type_array const neighbors = make_neighbors_array ( );
+    static constexpr symmetry_type_array const symmetries = make_symmetries_array ( );
 };
 
 template<typename Type, int R, bool zero_base>
@@ -265,6 +299,7 @@ struct HexContainer : public HexBase<R, zero_base> {
     using rad::width;
 
     using hex_base::neighbors;
+    using hex_base::symmetries;
 
     using size_type     = typename rad::size_type;
     using value_type    = Type;
@@ -31,9 +31,10 @@
 
 #include <algorithm>
 #include <array>
-#include <charconv>
+#include <limits>
 #include <sax/iostream.hpp>
 #include <random>
+#include <sstream>
 #include <string_view>
 #include <thread>
 #include <type_traits>
@@ -52,6 +53,7 @@
 #include "Player.hpp"
 #include "Hexcontainer.hpp"
 #include "Move.hpp"
+#include "Sampler.hpp"
 
 template<int R>
 struct PositionData {
@@ -72,6 +74,12 @@ struct PositionData {
     [[maybe_unused]] PositionData & operator= ( const PositionData & ) noexcept = default;
     [[maybe_unused]] PositionData & operator= ( PositionData && ) noexcept = default;
 
+    [[nodiscard]] bool operator== ( PositionData const & rhs_ ) const noexcept {
+        return m_slides == rhs_.m_slides and m_player_to_move == rhs_.m_player_to_move and
+               std::equal ( std::begin ( m_board ), std::end ( m_board ), std::begin ( rhs_.m_board ) );
+    }
+    [[nodiscard]] bool operator!= ( PositionData const & rhs_ ) const noexcept { return not operator== ( rhs_ ); }
+
     private:
     friend class cereal::access;
 
@@ -82,7 +90,42 @@ struct PositionData {
 };
 
 template<int R>
-using PositionDataVector = sax::singleton<std::vector<PositionData<R>>>;
+struct Wire::Layout<PositionData<R>> {
+
+    using Board = typename PositionData<R>::Board;
+    using Cell  = Layout<Player<R>>;
+
+    struct type {
+        typename Cell::type board[ Board::size ( ) ];
+        Little<std::int8_t> slides;
+        typename Cell::type player_to_move;
+    };
+
+    static_assert ( alignof ( type ) == 1, "a position is unaligned bytes" );
+
+    static constexpr std::uint32_t version = 1u;
+    static constexpr bool identity         = Cell::identity and sizeof ( PositionData<R> ) == sizeof ( type ); // no padding.
+
+    [[nodiscard]] static type pack ( PositionData<R> const & p_ ) noexcept {
+        type t;
+        for ( int i = 0; i < Board::size ( ); ++i )
+            t.board[ i ] = Cell::pack ( p_.m_board[ i ] );
+        t.slides         = p_.m_slides;
+        t.player_to_move = Cell::pack ( p_.m_player_to_move );
+        return t;
+    }
+    static void unpack ( type const & t_, PositionData<R> & p_ ) noexcept {
+        for ( int i = 0; i < Board::size ( ); ++i )
+            Cell::unpack ( t_.board[ i ], p_.m_board[ i ] );
+        p_.m_slides = t_.slides;
+        Cell::unpack ( t_.player_to_move, p_.m_player_to_move );
+    }
+};
+
+// The positions sampled by the (search) threads, nothing is sampled until it is started (the
+// writer of the sampler is the only writer of the log).
+template<int R>
+using PositionSampler = sax::singleton<Sampling::Sampler<PositionData<R>>>;
 
 template<int R>
 class Mado {
@@ -95,7 +138,6 @@ class Mado {
     using value_type = Player<R>;
 
     using PositionData = PositionData<R>;
-    using PDV          = PositionDataVector<R>;
     using Board        = typename PositionData::Board;
     using size_type    = typename Board::size_type;
 
@@ -107,12 +149,24 @@ class Mado {
 
     using SurroundedPlayerVector = std::experimental::fixed_capacity_vector<value_type, 6>;
 
+    using SymmetryGroup = std::experimental::fixed_capacity_vector<int, 11>; // Excluding the identity.
+    using MoveOrbit     = std::experimental::fixed_capacity_vector<Move, 12>;
+
+    // The features of the static evaluation, per player (by as_01index ( )), kept up to
+    // date by the moves. Edges are the sides of stones on the edge of the board, the
+    // frontier are the vacant cells next to a stone of the player.
+    struct Features {
+        std::array<std::int16_t, 2> stones, liberties, one_liberty, edges, frontier;
+    };
+
     private:
     PositionData m_pos;
     value_type m_winner;
     Generator m_generator;
     ZobristHash m_zobrist_hash; // Hash of the current m_board, some random initial value;
     std::array<Move, 2> m_last_move;
+    Features m_features;
+    std::array<std::array<std::int8_t, 2>, Board::size ( )> m_next_to; // The number of neighbors of each player.
 
     public:
     static constexpr ZobristHash const zobrist_hash_default = 0xb735a0f5839e4e22;
@@ -121,20 +175,36 @@ class Mado {
     int move_no, piece_no;
 
     Mado ( ) noexcept : m_generator ( Rng::generator ( ) ) { reset ( ); }
+    // A (non-terminal) position, the zobrist hash is not computed.
+    explicit Mado ( PositionData const & p_ ) noexcept :
+        m_pos ( p_ ), m_winner ( value::invalid ), m_generator ( Rng::generator ( ) ), m_zobrist_hash ( zobrist_hash_default ),
+        m_last_move{ }, m_features{ }, m_next_to{ }, move_no ( 0 ), piece_no ( 0 ) {
+        // Place the stones on an empty board.
+        std::fill ( std::begin ( m_pos.m_board ), std::end ( m_pos.m_board ), value_type{ } );
+        for ( int i = 0; i < Board::size ( ); ++i )
+            if ( p_.m_board[ i ].occupied ( ) ) {
+                occupy ( i, p_.m_board[ i ] );
+                ++piece_no;
+            }
+    }
     Mado ( Mado const & m_ ) noexcept :
         m_pos ( m_.m_pos ), m_winner ( m_.m_winner ), m_generator ( Rng::generator ( ) ), m_zobrist_hash ( m_.m_zobrist_hash ),
-        m_last_move ( m_.m_last_move ), move_no ( m_.move_no ), piece_no ( m_.piece_no ) {}
+        m_last_move ( m_.m_last_move ), m_features ( m_.m_features ), m_next_to ( m_.m_next_to ), move_no ( m_.move_no ),
+        piece_no ( m_.piece_no ) {}
     Mado ( Mado && m_ ) noexcept = delete;
 
     ~Mado ( ) noexcept {}
 
-    [[nodiscard]] Mado & operator= ( Mado const & m_ ) noexcept {
+    [[maybe_unused]] Mado & operator= ( Mado const & m_ ) noexcept {
         m_pos          = m_.m_pos;
         m_winner       = m_.m_winner;
         m_zobrist_hash = m_.m_zobrist_hash;
         m_last_move    = m_.m_last_move;
+        m_features     = m_.m_features;
+        m_next_to      = m_.m_next_to;
         move_no        = m_.move_no;
         piece_no       = m_.piece_no;
+        return *this;
     }
     [[nodiscard]] Mado & operator= ( Mado && m_ ) noexcept = delete;
 
@@ -145,28 +215,46 @@ class Mado {
         m_winner               = value::invalid;
         m_zobrist_hash         = zobrist_hash_default;
         m_last_move            = std::array<Move, 2>{ };
+        m_features             = Features{ };
+        m_next_to              = { };
         move_no                = 0;
         piece_no               = 0;
     }
 
     [[nodiscard]] ZobristHash zobrist ( ) const noexcept { return m_zobrist_hash; }
 
+    // The smallest zobrist hash of the 12 symmetric images of the position (computed afresh,
+    // so the moves need not have been hashed), symmetry_ is the one mapping the position
+    // onto that image (for transform ( )). The same for all equivalent positions.
+    [[nodiscard]] ZobristHash canonicalZobrist ( int & symmetry_ ) const noexcept {
+        ZobristHash common = zobrist_hash_default;
+        if ( m_pos.m_slides )
+            common ^= slides ( m_pos.m_slides );
+        if ( m_pos.m_player_to_move.agent ( ) )
+            common ^= zobrist_agent_to_move;
+        ZobristHash canonical = std::numeric_limits<ZobristHash>::max ( );
+        for ( int s = 0; s < 12; ++s ) {
+            auto const & symmetry = Board::symmetries[ s ];
+            ZobristHash h         = common;
+            for ( int i = 0; i < Board::size ( ); ++i )
+                if ( m_pos.m_board[ i ].occupied ( ) )
+                    h ^= hash ( m_pos.m_board[ i ], symmetry[ i ] );
+            if ( h < canonical ) {
+                canonical = h;
+                symmetry_ = s;
+            }
+        }
+        return canonical;
+    }
+    [[nodiscard]] PositionData const & position ( ) const noexcept { return m_pos; }
+    [[nodiscard]] Features const & features ( ) const noexcept { return m_features; }
+
     [[nodiscard]] value_type playerToMove ( ) const noexcept { return m_pos.m_player_to_move; }
     [[nodiscard]] value_type playerJustMoved ( ) const noexcept { return m_pos.m_player_to_move.opponent ( ); }
 
     void addPositionData ( ) {
         if ( std::bernoulli_distribution ( 0.0025 ) ( m_generator ) )
-            PDV::instance ( ).push_back ( m_pos );
-    }
-
-    void writePositionData ( ) {
-        if ( std::bernoulli_distribution ( 0.0025 ) ( m_generator ) ) {
-            static std::array<char, 21> str;
-            if ( auto [ p, ec ] = std::to_chars ( str.data ( ), str.data ( ) + str.size ( ),
-                                                  sax::uniform_int_distribution<std::uint64_t> ( ) ( m_generator ) );
-                 ec == std::errc ( ) )
-                saveToFileBin ( m_pos, "y://dict//", std::string_view ( str.data ( ), p - str.data ( ) ) );
-        }
+            PositionSampler<R>::instance ( ).push ( m_pos );
     }
 
     void move ( Move move_ ) noexcept {
@@ -232,6 +320,51 @@ class Mado {
         return moves;
     }
 
+    // The stabilizer (sub-group) of the position, i.e. the symmetries of the hexagon
+    // (other than the identity) that map the board onto itself.
+    [[nodiscard]] SymmetryGroup stabilizer ( ) const noexcept {
+        SymmetryGroup group;
+        for ( int s = 1; s < 12; ++s ) {
+            auto const & symmetry = Board::symmetries[ s ];
+            bool invariant        = true;
+            for ( int i = 0; invariant and i < Board::size ( ); ++i )
+                invariant = m_pos.m_board[ symmetry[ i ] ] == m_pos.m_board[ i ];
+            if ( invariant )
+                group.emplace_back ( s );
+        }
+        return group;
+    }
+
+    [[nodiscard]] static Move transform ( Move const move_, int const symmetry_ ) noexcept {
+        auto const & symmetry = Board::symmetries[ symmetry_ ];
+        return move_.is_placement ( ) ? Move{ symmetry[ move_.to ] } : Move{ symmetry[ move_.from ], symmetry[ move_.to ] };
+    }
+
+    // All moves equivalent to move_ under the group_ (move_ included, and first).
+    [[nodiscard]] static MoveOrbit orbit ( Move const move_, SymmetryGroup const & group_ ) noexcept {
+        MoveOrbit moves;
+        moves.emplace_back ( move_ );
+        for ( int const s : group_ )
+            if ( Move const m = transform ( move_, s );
+                 std::find ( std::begin ( moves ), std::end ( moves ), m ) == std::end ( moves ) )
+                moves.emplace_back ( m );
+        return moves;
+    }
+
+    // As availableMoves ( ), but only the representative (the smallest) move of each
+    // class of moves that are equivalent under the stabilizer of the position.
+    [[nodiscard]] Moves availableCanonicalMoves ( ) const noexcept {
+        SymmetryGroup const group = stabilizer ( );
+        if ( group.empty ( ) )
+            return availableMoves ( );
+        Moves moves;
+        for ( auto const move : availableMoves ( ) )
+            if ( std::none_of ( std::begin ( group ), std::end ( group ),
+                                [ move ] ( int const s ) noexcept { return transform ( move, s ) < move; } ) )
+                moves.emplace_back ( move );
+        return moves;
+    }
+
     [[nodiscard]] Move randomMove ( ) const noexcept {
         alignas ( 64 ) std::experimental::fixed_capacity_vector<Move, std::size_t{ Board::size ( ) } * std::size_t{ 2 }>
             available_moves;
@@ -244,11 +377,12 @@ class Mado {
         return randomMove ( );
     }
 
-    [[maybe_unused]] value_type simulate ( ) noexcept {
+    // Plays random moves until the game ends, or for at most max_plies_.
+    [[maybe_unused]] value_type simulate ( int max_plies_ = std::numeric_limits<int>::max ( ) ) noexcept {
         alignas ( 64 ) std::experimental::fixed_capacity_vector<Move, std::size_t{ Board::size ( ) } * std::size_t{ 2 }>
             available_moves;
         std::size_t s;
-        while ( nonterminal ( ) and ( s = availableMoves ( available_moves ) ) ) {
+        while ( max_plies_-- > 0 and nonterminal ( ) and ( s = availableMoves ( available_moves ) ) ) {
             moveWinner ( available_moves[ boundInt ( s ) ] );
             available_moves.clear ( );
         }
@@ -336,37 +470,42 @@ class Mado {
         }
     }
 
+    // From SplitMix64, the mixer.
+    [[nodiscard]] static constexpr std::uint64_t mix ( std::uint64_t k ) noexcept {
+        k = ( k ^ ( k >> 30 ) ) * std::uint64_t{ 0xbf58476d1ce4e5b9 };
+        k = ( k ^ ( k >> 27 ) ) * std::uint64_t{ 0x94d049bb133111eb };
+        return k ^ ( k >> 31 );
+    }
+    // Hash of a stone, never 0 (mix ( 0 ) is 0), nor equal to the hash of a slide count.
+    [[nodiscard]] static std::uint64_t hash ( value_type const p_, int const i_ ) noexcept {
+        return mix ( static_cast<std::uint64_t> ( p_.as_index ( ) + 2 ) << 32 | static_cast<std::uint64_t> ( i_ ) );
+    }
+    // Hash of the slide count.
+    [[nodiscard]] static constexpr std::uint64_t slides ( int const s_ ) noexcept {
+        return mix ( std::uint64_t{ 0x100 } + static_cast<std::uint64_t> ( s_ ) );
+    }
+    // Hashed-in when the agent is to move.
+    static constexpr ZobristHash const zobrist_agent_to_move = 0xa9063818575b53b7;
+
     // Move and update zobrist-hash.
     void moveHashImplementation ( Move const move_ ) noexcept {
-        // From SplitMix64, the mixer.
-        auto mix = [] ( std::uint64_t k ) -> std::uint64_t {
-            k = ( k ^ ( k >> 30 ) ) * std::uint64_t{ 0xbf58476d1ce4e5b9 };
-            k = ( k ^ ( k >> 27 ) ) * std::uint64_t{ 0x94d049bb133111eb };
-            return k ^ ( k >> 31 );
-        };
-        // Hash.
-        auto hash = [ mix ] ( auto p, auto i ) -> std::uint64_t {
-            return mix ( static_cast<std::uint64_t> ( p.as_index ( ) ) ^ static_cast<std::uint64_t> ( i ) );
-        };
-        // The start of the function, proper.
         if ( move_.is_placement ( ) ) { // Place.
             if ( m_pos.m_slides )
-                m_zobrist_hash ^= mix ( static_cast<std::uint64_t> ( m_pos.m_slides ) );
+                m_zobrist_hash ^= slides ( m_pos.m_slides );
             m_pos.m_slides = 0;
             ++piece_no;
         }
         else { // Slide.
             if ( m_pos.m_slides )
-                m_zobrist_hash ^= mix ( static_cast<std::uint64_t> ( m_pos.m_slides ) );
-            m_zobrist_hash ^= mix ( static_cast<std::uint64_t> ( ++m_pos.m_slides ) );
+                m_zobrist_hash ^= slides ( m_pos.m_slides );
+            m_zobrist_hash ^= slides ( ++m_pos.m_slides );
             m_zobrist_hash ^= hash ( m_pos.m_player_to_move, move_.from );
-            m_pos.m_board[ move_.from ] = value::vacant;
+            vacate ( move_.from );
         }
-        m_pos.m_board[ move_.to ] = m_pos.m_player_to_move;
+        occupy ( move_.to, m_pos.m_player_to_move );
         m_zobrist_hash ^= hash ( m_pos.m_player_to_move, move_.to );
-        // Alternatingly hash-in and hash-out the below value (0xa9063818575b53b7),
-        // to add-in the current player.
-        m_zobrist_hash ^= 0xa9063818575b53b7;
+        // Alternatingly hash-in and hash-out zobrist_agent_to_move, to add-in the current player.
+        m_zobrist_hash ^= zobrist_agent_to_move;
         ++move_no;
     }
 
@@ -378,12 +517,66 @@ class Mado {
         }
         else { // Slide.
             ++m_pos.m_slides;
-            m_pos.m_board[ move_.from ] = value::vacant;
+            vacate ( move_.from );
         }
-        m_pos.m_board[ move_.to ] = m_pos.m_player_to_move;
+        occupy ( move_.to, m_pos.m_player_to_move );
         ++move_no;
     }
 
+    // Placing or removing a stone only changes the features of the cell and its neighbors,
+    // the liberties of a stone are its neighbors less the neighbors of either player.
+    [[nodiscard]] int liberties ( int const idx_ ) const noexcept {
+        return static_cast<int> ( Board::neighbors[ idx_ ].size ( ) ) - m_next_to[ idx_ ][ 0 ] - m_next_to[ idx_ ][ 1 ];
+    }
+
+    void occupy ( int const idx_, value_type const p_ ) noexcept {
+        auto const i = p_.as_01index ( );
+        int const l  = liberties ( idx_ );
+        m_features.frontier[ 0 ] -= m_next_to[ idx_ ][ 0 ] > 0;
+        m_features.frontier[ 1 ] -= m_next_to[ idx_ ][ 1 ] > 0;
+        m_features.stones[ i ] += 1;
+        m_features.liberties[ i ] += l;
+        m_features.one_liberty[ i ] += 1 == l;
+        m_features.edges[ i ] += 6 - static_cast<int> ( Board::neighbors[ idx_ ].size ( ) );
+        m_pos.m_board[ idx_ ] = p_;
+        for ( auto const neighbor : Board::neighbors[ idx_ ] ) {
+            value_type const n = m_pos.m_board[ neighbor ];
+            if ( n.vacant ( ) ) {
+                m_features.frontier[ i ] += 0 == m_next_to[ neighbor ][ i ]++;
+                continue;
+            }
+            ++m_next_to[ neighbor ][ i ];
+            auto const j = n.as_01index ( );
+            int const ln = liberties ( neighbor ); // One less.
+            m_features.liberties[ j ] -= 1;
+            m_features.one_liberty[ j ] += ( 1 == ln ) - ( 0 == ln );
+        }
+    }
+
+    void vacate ( int const idx_ ) noexcept {
+        auto const i = m_pos.m_board[ idx_ ].as_01index ( );
+        int const l  = liberties ( idx_ );
+        m_features.stones[ i ] -= 1;
+        m_features.liberties[ i ] -= l;
+        m_features.one_liberty[ i ] -= 1 == l;
+        m_features.edges[ i ] -= 6 - static_cast<int> ( Board::neighbors[ idx_ ].size ( ) );
+        m_features.frontier[ 0 ] += m_next_to[ idx_ ][ 0 ] > 0;
+        m_features.frontier[ 1 ] += m_next_to[ idx_ ][ 1 ] > 0;
+        m_pos.m_board[ idx_ ] = value::vacant;
+        for ( auto const neighbor : Board::neighbors[ idx_ ] ) {
+            value_type const n = m_pos.m_board[ neighbor ];
+            if ( n.vacant ( ) ) {
+                m_features.frontier[ i ] -= 0 == --m_next_to[ neighbor ][ i ];
+                continue;
+            }
+            --m_next_to[ neighbor ][ i ];
+            auto const j = n.as_01index ( );
+            int const ln = liberties ( neighbor ); // One more.
+            m_features.liberties[ j ] += 1;
+            m_features.one_liberty[ j ] += ( 1 == ln ) - ( 2 == ln );
+        }
+    }
+
     template<typename IdxType>
     [[nodiscard]] inline bool isSurrounded ( IdxType const idx_ ) const noexcept {
         for ( auto const neighbor : Board::neighbors[ idx_ ] )
@@ -401,22 +594,44 @@ class Mado {
         return sax::uniform_int_distribution<T> ( l_, u_ - T{ 1 } ) ( m_generator );
     }
 
+    // Serialized on the calling thread, written by the disk writer (in the background), throws
+    // iff the writer is closed (the errors of the writes are reported by Disk::instance ( ).sync ( )).
     template<typename T>
-    void saveToFileBin ( T const & t_, sf::Path && path_, std::string_view && file_name_, bool const append_ = false ) noexcept {
-        std::ofstream ostream ( path_ / file_name_,
-                                append_ ? std::ios::binary | std::ios::app | std::ios::out : std::ios::binary | std::ios::out );
+    void saveToFileBin ( T const & t_, sf::Path && path_, std::string_view && file_name_, bool const append_ = false ) {
+        std::ostringstream ostream ( std::ios::binary | std::ios::out );
         {
             cereal::BinaryOutputArchive archive ( ostream );
             archive ( t_ );
         }
-        ostream.flush ( );
-        ostream.close ( );
+        if ( append_ )
+            Disk::instance ( ).append ( path_ / file_name_, ostream.str ( ) );
+        else
+            Disk::instance ( ).write ( path_ / file_name_, ostream.str ( ) );
     }
 
     friend class cereal::access;
 
     template<class Archive>
-    void serialize ( Archive & ar_ ) {
+    void save ( Archive & ar_ ) const {
         ar_ ( m_pos );
     }
+
+    // Only the position is archived, the features, the neighbor counts and the zobrist
+    // hash are rebuilt from it.
+    template<class Archive>
+    void load ( Archive & ar_ ) {
+        PositionData p;
+        ar_ ( p );
+        reset ( );
+        for ( int i = 0; i < Board::size ( ); ++i )
+            if ( p.m_board[ i ].occupied ( ) ) {
+                occupy ( i, p.m_board[ i ] );
+                m_zobrist_hash ^= hash ( p.m_board[ i ], i );
+                ++piece_no;
+            }
+        if ( ( m_pos.m_slides = p.m_slides ) )
+            m_zobrist_hash ^= slides ( m_pos.m_slides );
+        if ( ( m_pos.m_player_to_move = p.m_player_to_move ).agent ( ) )
+            m_zobrist_hash ^= zobrist_agent_to_move;
+    }
 };
@@ -0,0 +1,127 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#if defined( _WIN32 )
+#    ifndef NOMINMAX
+#        define NOMINMAX
+#    endif
+#    include <Windows.h>
+#else
+#    include <fcntl.h>
+#    include <sys/mman.h>
+#    include <sys/stat.h>
+#    include <unistd.h>
+#endif
+
+#include <cstddef>
+#include <cstdint>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+
+#include "MappedFile.hpp"
+
+#if defined( _WIN32 )
+static_assert ( sizeof ( std::intptr_t ) == sizeof ( HANDLE ) );
+#endif
+
+MappedFile::MappedFile ( std::filesystem::path const & path_ ) {
+#if defined( _WIN32 )
+    HANDLE const file = CreateFileW ( path_.c_str ( ), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+                                      FILE_ATTRIBUTE_NORMAL | FILE_FLAG_RANDOM_ACCESS, nullptr );
+    if ( INVALID_HANDLE_VALUE == file )
+        throw std::runtime_error ( "MappedFile: cannot open " + path_.string ( ) );
+    m_file = reinterpret_cast<std::intptr_t> ( file );
+    LARGE_INTEGER size;
+    if ( not GetFileSizeEx ( file, &size ) ) {
+        close ( );
+        throw std::runtime_error ( "MappedFile: cannot stat " + path_.string ( ) );
+    }
+    m_size = static_cast<std::size_t> ( size.QuadPart );
+    if ( m_size ) {
+        m_mapping = CreateFileMappingW ( file, nullptr, PAGE_READONLY, 0, 0, nullptr );
+        if ( m_mapping )
+            m_data = static_cast<std::uint8_t const *> ( MapViewOfFile ( m_mapping, FILE_MAP_READ, 0, 0, 0 ) );
+        if ( not m_data ) {
+            close ( );
+            throw std::runtime_error ( "MappedFile: cannot map " + path_.string ( ) );
+        }
+    }
+#else
+    m_file = ::open ( path_.c_str ( ), O_RDONLY );
+    if ( -1 == m_file )
+        throw std::runtime_error ( "MappedFile: cannot open " + path_.string ( ) );
+    struct stat st;
+    if ( -1 == ::fstat ( static_cast<int> ( m_file ), &st ) ) {
+        close ( );
+        throw std::runtime_error ( "MappedFile: cannot stat " + path_.string ( ) );
+    }
+    m_size = static_cast<std::size_t> ( st.st_size );
+    if ( m_size ) {
+        void * p = ::mmap ( nullptr, m_size, PROT_READ, MAP_SHARED, static_cast<int> ( m_file ), 0 );
+        if ( MAP_FAILED == p ) {
+            close ( );
+            throw std::runtime_error ( "MappedFile: cannot map " + path_.string ( ) );
+        }
+        m_data = static_cast<std::uint8_t const *> ( p );
+    }
+#endif
+}
+
+void MappedFile::close ( ) noexcept {
+#if defined( _WIN32 )
+    if ( m_data )
+        UnmapViewOfFile ( m_data );
+    if ( m_mapping )
+        CloseHandle ( m_mapping );
+    if ( -1 != m_file )
+        CloseHandle ( reinterpret_cast<HANDLE> ( m_file ) );
+#else
+    if ( m_data )
+        ::munmap ( const_cast<std::uint8_t *> ( m_data ), m_size );
+    if ( -1 != m_file )
+        ::close ( static_cast<int> ( m_file ) );
+#endif
+    m_file    = -1;
+    m_mapping = nullptr;
+    m_data    = nullptr;
+    m_size    = 0u;
+}
+
+void MappedFile::advise ( Access const access_ ) const noexcept {
+    if ( not m_data )
+        return;
+#if defined( _WIN32 )
+    if ( Access::will_need == access_ ) {
+        WIN32_MEMORY_RANGE_ENTRY range{ const_cast<std::uint8_t *> ( m_data ), m_size };
+        PrefetchVirtualMemory ( GetCurrentProcess ( ), 1, &range, 0 );
+    }
+#else
+    int const advice = Access::sequential == access_ ? MADV_SEQUENTIAL
+                       : Access::random == access_   ? MADV_RANDOM
+                       : Access::will_need == access_ ? MADV_WILLNEED
+                                                     : MADV_NORMAL;
+    ::madvise ( const_cast<std::uint8_t *> ( m_data ), m_size, advice );
+#endif
+}
@@ -0,0 +1,80 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <filesystem>
+#include <stdexcept>
+#include <string>
+#include <utility>
+
+// A read-only memory mapping of a (whole) file, the pages are loaded on access, and are
+// shared between processes mapping the same file.
+class MappedFile {
+
+    public:
+    MappedFile ( ) noexcept = default;
+
+    // The platform code (and <Windows.h>) is in MappedFile.cpp.
+    explicit MappedFile ( std::filesystem::path const & path_ );
+
+    MappedFile ( MappedFile const & ) = delete;
+    MappedFile ( MappedFile && m_ ) noexcept { swap ( m_ ); }
+
+    ~MappedFile ( ) noexcept { close ( ); }
+
+    MappedFile & operator= ( MappedFile const & ) = delete;
+    MappedFile & operator= ( MappedFile && m_ ) noexcept {
+        close ( );
+        swap ( m_ );
+        return *this;
+    }
+
+    void close ( ) noexcept;
+
+    enum class Access { normal, sequential, random, will_need };
+
+    // A hint to the OS, on how the pages will be accessed (Windows only prefetches).
+    void advise ( Access const access_ ) const noexcept;
+
+    [[nodiscard]] bool is_open ( ) const noexcept { return nullptr != m_data; }
+    [[nodiscard]] std::uint8_t const * data ( ) const noexcept { return m_data; }
+    [[nodiscard]] std::size_t size ( ) const noexcept { return m_size; }
+
+    private:
+    void swap ( MappedFile & m_ ) noexcept {
+        std::swap ( m_file, m_.m_file );
+        std::swap ( m_mapping, m_.m_mapping );
+        std::swap ( m_data, m_.m_data );
+        std::swap ( m_size, m_.m_size );
+    }
+
+    std::intptr_t m_file        = -1;      // the HANDLE (INVALID_HANDLE_VALUE is -1), or the file descriptor.
+    void * m_mapping            = nullptr; // the HANDLE of the mapping (Windows only).
+    std::uint8_t const * m_data = nullptr;
+    std::size_t m_size          = 0u;
+};
@@ -71,9 +71,13 @@
 #include <cstddef>
 #include <cstdint>
 #include <cstdlib>
+#include <cstring>
 
 #include <algorithm>
+#include <atomic>
 #include <chrono>
+#include <filesystem>
+#include <fstream>
 #include <functional>
 #include <future>
 #include <iomanip>
@@ -89,11 +93,24 @@
 #include <utility>
 #include <vector>
 
+#if defined( __cpp_impl_coroutine )
+#    include <coroutine>
+#elif defined( __cpp_coroutines )
+#    include <experimental/coroutine>
+#endif
+
 #include <cereal/cereal.hpp>
 #include <cereal/archives/binary.hpp>
 #include <cereal/types/vector.hpp>
 
+#include "Book.hpp"
 #include "Globals.hpp"
+#include "MappedFile.hpp"
+#include "NeuralNet.hpp"
+#include "ProofNumber.hpp"
+#include "StaticEval.hpp"
+#include "ThreatSpace.hpp"
+#include "Wire.hpp"
 
 // #include <pector/malloc_allocator.h>
 // #include <pector/mimalloc_allocator.h>
@@ -110,15 +127,100 @@ using pector = pt::pector<T, std::allocator<T>, int, pt::default_recommended_siz
 
 namespace Mcts {
 
+#if defined( __cpp_impl_coroutine ) or defined( __cpp_coroutines )
+#    if defined( __cpp_impl_coroutine )
+using std::coroutine_handle;
+using std::suspend_always;
+#    else
+using std::experimental::coroutine_handle;
+using std::experimental::suspend_always;
+#    endif
+
+// A minimal generator, the coroutine runs up to the next co_yield on every next ( ).
+template<typename T>
+class Generator {
+
+    public:
+    struct promise_type {
+
+        T value;
+
+        [[nodiscard]] Generator get_return_object ( ) noexcept { return Generator{ handle::from_promise ( *this ) }; }
+        [[nodiscard]] suspend_always initial_suspend ( ) const noexcept { return { }; }
+        [[nodiscard]] suspend_always final_suspend ( ) const noexcept { return { }; }
+        [[nodiscard]] suspend_always yield_value ( T value_ ) noexcept {
+            value = std::move ( value_ );
+            return { };
+        }
+        void return_void ( ) const noexcept {}
+        void unhandled_exception ( ) { throw; }
+    };
+
+    using handle = coroutine_handle<promise_type>;
+
+    Generator ( Generator const & ) = delete;
+    Generator ( Generator && g_ ) noexcept : m_handle ( std::exchange ( g_.m_handle, nullptr ) ) {}
+
+    ~Generator ( ) noexcept {
+        if ( m_handle )
+            m_handle.destroy ( );
+    }
+
+    Generator & operator= ( Generator const & ) = delete;
+    Generator & operator= ( Generator && ) = delete;
+
+    // Resumes the coroutine, returns false once it has finished.
+    [[nodiscard]] bool next ( ) {
+        m_handle.resume ( );
+        return not m_handle.done ( );
+    }
+    [[nodiscard]] T const & value ( ) const noexcept { return m_handle.promise ( ).value; }
+
+    private:
+    explicit Generator ( handle h_ ) noexcept : m_handle ( h_ ) {}
+
+    handle m_handle;
+};
+#endif
+
+// The constants of the search. In production builds they are static constexpr, i.e.
+// compile to constants, in tuning builds (MADO_TUNING defined) they are members, so the
+// engines of a match can differ (and they are read from a parameter file, see Tuning.hpp).
+#ifdef MADO_TUNING
+#    define MADO_TUNABLE( name, value ) float name = value
+#else
+#    define MADO_TUNABLE( name, value ) static constexpr float name = value
+#endif
+
+struct Constants {
+    MADO_TUNABLE ( uct_exploration, 2.0f ); // the C of UCT, sqrt ( C * ln ( N ) / n ).
+    MADO_TUNABLE ( final_prior_wins, 1.0f ); // the Beta prior of the final move selection.
+    MADO_TUNABLE ( final_prior_losses, 1.0f );
+};
+
 struct ComputeOptions {
 
     int number_of_threads;
     int max_iterations;
     float max_time;
+    int symmetry_plies; // expand only one move per class of symmetric moves, up to this depth.
+    std::size_t max_memory; // in bytes, for all trees together, 0 is no limit.
+    std::atomic<bool> const * stop; // iff not nullptr, the search stops as soon as *stop is true.
+    std::int64_t solver_nodes; // iff > 0, first try to prove a win with df-pn, within this many nodes.
+    int threat_depth; // iff > 0, first look for a win by at most this many threats.
+    int playout_threat_depth; // iff >= 0, in the playouts, take the wins by at most this many threats.
+    int playout_cutoff; // iff > 0, the playouts stop after this many moves, and are scored by the static evaluation.
+    StaticEval::Weights evaluation;
+    NeuralNet::Evaluator * evaluator; // iff not nullptr, PUCT, the leaves are evaluated by the network, not played out.
+    float c_puct; // the weight of the priors (of the network) in PUCT.
+    Constants constants;
+    Book::Probe const * book; // iff not nullptr, the moves in the book are played without a search.
     bool verbose;
 
     ComputeOptions ( ) :
         number_of_threads ( 1 ), max_iterations ( 1'000'000 ), max_time ( 30.0 ), // default is no time limit.
+        symmetry_plies ( 2 ), max_memory ( 0 ), stop ( nullptr ), solver_nodes ( 0 ), threat_depth ( 0 ),
+        playout_threat_depth ( -1 ), playout_cutoff ( 0 ), evaluator ( nullptr ), c_puct ( 1.5f ), book ( nullptr ),
         verbose ( true ) {}
 };
 
@@ -212,21 +314,30 @@ struct Node {
         float wins = 0.0f; // 24
         Moves moves;       // 32
         // Hash hash;
-        Move move;     // 34
-        Player player; // 35
+        Move move;          // 34
+        Player player;      // 35
+        float prior = 0.0f; // 40, of the move, in PUCT.
 
         private:
         friend class cereal::access;
 
+        // The moves are written in one go by binary archives (the bytes are the same as
+        // those of the moves one by one, to, from), one by one by the others.
         template<class Archive>
         void save ( Archive & ar_ ) const {
             ar_ ( visits, wins );
             int s = moves.size ( );
             ar_ ( s );
-            for ( int i = 0; i < s; ++i )
-                ar_ ( moves[ i ] );
+            if constexpr ( cereal::traits::is_output_serializable<cereal::BinaryData<Move const *>, Archive>::value ) {
+                if ( s )
+                    ar_ ( cereal::binary_data ( &moves[ 0 ], s * sizeof ( Move ) ) );
+            }
+            else {
+                for ( int i = 0; i < s; ++i )
+                    ar_ ( moves[ i ] );
+            }
             // ar_ ( hash );
-            ar_ ( move, player );
+            ar_ ( move, player, prior );
         }
 
         template<class Archive>
@@ -236,11 +347,16 @@ struct Node {
             ar_ ( s );
             if ( s ) {
                 moves.resize ( s );
-                for ( int i = 0; i < s; ++i )
-                    ar_ ( moves[ i ] );
+                if constexpr ( cereal::traits::is_input_serializable<cereal::BinaryData<Move *>, Archive>::value ) {
+                    ar_ ( cereal::binary_data ( &moves[ 0 ], s * sizeof ( Move ) ) );
+                }
+                else {
+                    for ( int i = 0; i < s; ++i )
+                        ar_ ( moves[ i ] );
+                }
             }
             // ar_ ( hash );
-            ar_ ( move, player );
+            ar_ ( move, player, prior );
         }
     };
 
@@ -263,6 +379,12 @@ struct Node {
         data.move   = move_;
         data.player = state.playerToMove ( );
     }
+    // A leaf (of PUCT), its moves are only generated once it is reached.
+    Node ( Move const & move_, Player const player_, float const prior_ ) noexcept {
+        data.move   = move_;
+        data.player = player_;
+        data.prior  = prior_;
+    }
     Node ( Data && data_ ) noexcept : data{ std::move ( data_ ) } {}
     Node ( Data const & data_ ) : data{ data_ } {}
 
@@ -330,14 +452,14 @@ template<typename State, typename... Args>
 }
 
 template<typename State>
-[[nodiscard]] NodeID select_child_uct ( Tree<State> const & tree_, NodeID parent_ ) noexcept {
+[[nodiscard]] NodeID select_child_uct ( Tree<State> const & tree_, NodeID parent_, float const exploration_ ) noexcept {
     attest ( tree_[ parent_ ( ) ].size );
     NodeID best_child;
     float best_utc_score = std::numeric_limits<float>::lowest ( );
     for ( NodeID child = tree_[ parent_ ( ) ].tail; NodeID::invalid ( ) != child; child = tree_[ child ( ) ].prev ) {
         auto & c        = tree_[ child ( ) ].data;
         float utc_score = ( c.wins / 2.0f ) / static_cast<float> ( c.visits ) +
-                          std::sqrtf ( 2.0f * std::logf ( static_cast<float> ( tree_[ parent_ ( ) ].data.visits ) ) /
+                          std::sqrtf ( exploration_ * std::logf ( static_cast<float> ( tree_[ parent_ ( ) ].data.visits ) ) /
                                        static_cast<float> ( c.visits ) );
         if ( utc_score > best_utc_score ) {
             best_child     = child;
@@ -347,6 +469,27 @@ template<typename State>
     return best_child;
 }
 
+// PUCT (AlphaZero), the children that were not visited yet get the value of the parent.
+template<typename State>
+[[nodiscard]] NodeID select_child_puct ( Tree<State> const & tree_, NodeID parent_, float const c_puct_ ) noexcept {
+    attest ( tree_[ parent_ ( ) ].size );
+    auto const & p               = tree_[ parent_ ( ) ].data;
+    float const sqrt_visits      = std::sqrtf ( static_cast<float> ( p.visits ) );
+    float const first_play_value = p.visits ? 1.0f - p.wins / static_cast<float> ( p.visits ) : 0.5f;
+    NodeID best_child;
+    float best_puct_score = std::numeric_limits<float>::lowest ( );
+    for ( NodeID child = tree_[ parent_ ( ) ].tail; NodeID::invalid ( ) != child; child = tree_[ child ( ) ].prev ) {
+        auto & c         = tree_[ child ( ) ].data;
+        float puct_score = ( c.visits ? c.wins / static_cast<float> ( c.visits ) : first_play_value ) +
+                           c_puct_ * c.prior * sqrt_visits / static_cast<float> ( 1 + c.visits );
+        if ( puct_score > best_puct_score ) {
+            best_child      = child;
+            best_puct_score = puct_score;
+        }
+    }
+    return best_child;
+}
+
 template<typename State>
 std::string tree_to_string ( Tree<State> const & tree_, NodeID parent_, int max_depth_ = 1'000'000, int indent_ = 0 ) {
     auto indent_string = [] ( int indent_ ) -> std::string {
@@ -393,81 +536,314 @@ void flatten ( Tree<State> & tree_ ) {
     Tree<State> sub_tree;
     sub_tree.reserve ( 64 );
     sub_tree.emplace_back ( );
-    add_child ( sub_tree, NodeID{ 0 }, std::move ( tree_[ root_ ( ) ].data ) ); // add root state data
+    add_child ( sub_tree, NodeID{ 0 }, std::move ( tree_[ root_node ( ) ].data ) ); // add root state data
     for ( NodeID child = tree_[ root_node ( ) ].tail; NodeID::invalid ( ) != child; child = tree_[ child ( ) ].prev )
         add_child ( sub_tree, root_node, std::move ( tree_[ child ( ) ].data ) );
     std::swap ( tree_, sub_tree );
 }
 
+// An estimate of the memory held by a node, its (untried) moves included.
 template<typename State>
-Results<State> compute_tree ( std::reference_wrapper<Tree<State>> tree_, State const root_state_, ComputeOptions const options_ ) {
+[[nodiscard]] std::size_t node_memory ( Node<State> const & node_ ) noexcept {
+    return sizeof ( Node<State> ) + static_cast<std::size_t> ( node_.data.moves.capacity ( ) ) * sizeof ( typename State::Move );
+}
+
+// The memory in use by the tree, the reserved (but untouched) capacity is not counted.
+template<typename State>
+[[nodiscard]] std::size_t memory_usage ( Tree<State> const & tree_ ) noexcept {
+    std::size_t m = 0u;
+    for ( auto const & node : tree_ )
+        m += node_memory<State> ( node );
+    return m;
+}
+
+// Keeps the most visited part of the tree. The nodes with no more than the median
+// number of visits are frozen, i.e. they lose their sub-trees and their untried
+// moves, they remain in the tree as leaves, that are played out from (or, in PUCT,
+// evaluated), but that are no longer expanded. The ( remaining ) nodes are stored in their original
+// order, as children are always added after their parent, one pass suffices.
+template<typename State>
+void compact ( Tree<State> & tree_ ) {
+    int const n = tree_.size ( );
+    if ( n < 3 )
+        return;
+    std::vector<int> visits;
+    visits.reserve ( n - 2 );
+    for ( int i = 2; i < n; ++i )
+        visits.push_back ( tree_[ i ].data.visits );
+    auto median = std::begin ( visits ) + visits.size ( ) / 2;
+    std::nth_element ( std::begin ( visits ), median, std::end ( visits ) );
+    int const threshold = *median;
+    auto frozen         = [ &tree_, threshold ] ( int const i_ ) noexcept {
+        return root_node ( ) != i_ and tree_[ i_ ].data.visits <= threshold;
+    };
+    std::vector<NodeID> kept ( n ); // The new ids, invalid if dropped.
+    kept[ root_node ( ) ] = root_node;
+    int size              = root_node ( ) + 1;
+    for ( int i = 2; i < n; ++i )
+        if ( int const up = tree_[ i ].up ( ); NodeID::invalid ( ) != kept[ up ] and not frozen ( up ) )
+            kept[ i ] = NodeID{ size++ };
+    Tree<State> sub_tree;
+    sub_tree.reserve ( size );
+    sub_tree.emplace_back ( );
+    add_child ( sub_tree, NodeID{ 0 }, std::move ( tree_[ root_node ( ) ].data ) ); // add root state data
+    for ( int i = 2; i < n; ++i ) {
+        if ( NodeID::invalid ( ) == kept[ i ] )
+            continue;
+        bool const is_frozen = frozen ( i );
+        NodeID const child   = add_child ( sub_tree, kept[ tree_[ i ].up ( ) ], std::move ( tree_[ i ].data ) );
+        attest ( kept[ i ] == child );
+        if ( is_frozen )
+            sub_tree[ child ( ) ].data.moves.reset ( );
+    }
+    std::swap ( tree_, sub_tree );
+}
+
+// Makes the child of the root reached by move_ the new root, keeping its sub-tree
+// (and all of its statistics), returns false (leaving the tree as is) iff there is
+// no such child.
+template<typename State>
+[[nodiscard]] bool reroot ( Tree<State> & tree_, typename State::Move const move_ ) {
+    NodeID new_root = NodeID::invalid ( );
+    for ( NodeID child = tree_[ root_node ( ) ].tail; NodeID::invalid ( ) != child; child = tree_[ child ( ) ].prev )
+        if ( tree_[ child ( ) ].data.move == move_ )
+            new_root = child;
+    if ( NodeID::invalid ( ) == new_root )
+        return false;
+    int const n = tree_.size ( );
+    std::vector<NodeID> kept ( n ); // The new ids, invalid if dropped.
+    kept[ new_root ( ) ] = root_node;
+    int size             = root_node ( ) + 1;
+    for ( int i = new_root ( ) + 1; i < n; ++i )
+        if ( NodeID::invalid ( ) != kept[ tree_[ i ].up ( ) ] )
+            kept[ i ] = NodeID{ size++ };
+    Tree<State> sub_tree;
+    sub_tree.reserve ( size );
+    sub_tree.emplace_back ( );
+    add_child ( sub_tree, NodeID{ 0 }, std::move ( tree_[ new_root ( ) ].data ) ); // add root state data
+    sub_tree[ root_node ( ) ].data.move = State::no_move;
+    for ( int i = new_root ( ) + 1; i < n; ++i )
+        if ( NodeID::invalid ( ) != kept[ i ] )
+            add_child ( sub_tree, kept[ tree_[ i ].up ( ) ], std::move ( tree_[ i ].data ) );
+    std::swap ( tree_, sub_tree );
+    return true;
+}
+
+// As reroot ( ), but iff move_ is not a child of the root (the root was expanded by the
+// representatives of the classes of equivalent moves, see symmetry_plies), the sub-tree of
+// the equivalent child is kept, mapped onto move_, i.e. all its moves are transformed by the
+// symmetry (of root_state_, the state of the root) that maps the one onto the other.
+template<typename State>
+[[nodiscard]] bool reroot ( Tree<State> & tree_, State const & root_state_, typename State::Move const move_ ) {
+    if ( reroot ( tree_, move_ ) )
+        return true;
+    for ( int const s : root_state_.stabilizer ( ) )
+        for ( NodeID child = tree_[ root_node ( ) ].tail; NodeID::invalid ( ) != child; child = tree_[ child ( ) ].prev )
+            if ( State::transform ( tree_[ child ( ) ].data.move, s ) == move_ ) {
+                // s maps the root state onto itself, so it maps the position after the child
+                // onto the position after move_, and the moves of the one onto those of the other.
+                if ( not reroot ( tree_, tree_[ child ( ) ].data.move ) )
+                    return false;
+                for ( int i = root_node ( ) + 1; i < static_cast<int> ( tree_.size ( ) ); ++i )
+                    tree_[ i ].data.move = State::transform ( tree_[ i ].data.move, s );
+                for ( int i = root_node ( ); i < static_cast<int> ( tree_.size ( ) ); ++i )
+                    for ( int m = 0; m < static_cast<int> ( tree_[ i ].data.moves.size ( ) ); ++m )
+                        tree_[ i ].data.moves[ m ] = State::transform ( tree_[ i ].data.moves[ m ], s );
+                return true;
+            }
+    return false;
+}
+
+// Expected success rate assuming a Beta(a, b) prior, the default is uniform (Beta(1, 1)).
+// https://en.wikipedia.org/wiki/Beta_distribution
+[[nodiscard]] constexpr float expected_success_rate ( float const wins_, float const visits_, float const a_ = 1.0f,
+                                                      float const b_ = 1.0f ) noexcept {
+    return ( wins_ + a_ ) / ( visits_ + a_ + b_ );
+}
+
+// Runs the iterations (select, expand, play out and back-propagate) on tree_.
+template<typename State>
+void search_tree ( Tree<State> & tree_, State const & root_state_, ComputeOptions const & options_ ) {
     static_assert ( std::is_copy_assignable<Node<State>>::value, "Node<State> is not copy-assignable" );
     static_assert ( std::is_move_assignable<Node<State>>::value, "Node<State> is not move-assignable" );
-    Tree<State> & tree       = tree_.get ( );
+    Tree<State> & tree       = tree_;
     sax::Rng & random_engine = Rng::generator ( );
-    attest ( options_.max_iterations >= 0 or options_.max_time >= 0 );
+    attest ( options_.max_iterations >= 0 or options_.max_time >= 0 or options_.stop );
+    // Only expand one move of each class of equivalent moves at a fresh root.
+    if ( options_.symmetry_plies > 0 and not tree[ root_node ( ) ].has_children ( ) and
+         tree[ root_node ( ) ].has_untried_moves ( ) )
+        tree[ root_node ( ) ].data.moves = root_state_.availableCanonicalMoves ( );
     double start_time = wall_time ( ), print_time = start_time;
+    // Every thread gets an equal share of the memory budget. Once the budget is spent,
+    // the tree is compacted, if that does not free up at least a quarter of the budget,
+    // expansion stops, and the search carries on playing out from the existing leaves.
+    std::size_t const max_memory = options_.max_memory / static_cast<std::size_t> ( std::max ( options_.number_of_threads, 1 ) );
+    std::size_t memory           = max_memory ? memory_usage ( tree ) : 0u;
+    bool expand                  = true;
     for ( int iter = 1; iter <= options_.max_iterations or options_.max_iterations < 0; ++iter ) {
         NodeID node = root_node;
         State state = root_state_;
+        int depth   = 0;
         // Select a path through the tree to a leaf node.
         while ( not tree[ node ( ) ].has_untried_moves ( ) and tree[ node ( ) ].has_children ( ) ) {
-            node = select_child_uct ( tree, node );
-            state.move ( tree[ node ( ) ].data.move );
+            if ( options_.evaluator ) {
+                node = select_child_puct ( tree, node, options_.c_puct );
+                state.moveWinner ( tree[ node ( ) ].data.move );
+            }
+            else {
+                node = select_child_uct ( tree, node, options_.constants.uct_exploration );
+                state.move ( tree[ node ( ) ].data.move );
+            }
+            ++depth;
         }
-        // If we are not already at the final state, expand the tree with a new node ( ) and Move there.
-        if ( tree[ node ( ) ].has_untried_moves ( ) ) {
-            auto move = tree[ node ( ) ].get_untried_move ( random_engine );
-            state.moveWinner ( move );
-            node = add_child ( tree, node, state, move );
-        }
-        for ( int i = 0; i < 1; ++i ) {
-            State sim_state = state;
-            // We now play randomly until the game ends.
-            sim_state.simulate ( );
-            // We have now reached a final state. Backpropagate the result up the tree to the root node ( ).
-            while ( NodeID::invalid ( ) != node ) {
-                tree[ node ( ) ].update ( sim_state.result ( tree[ node ( ) ].data.player ) );
-                node = tree[ node ( ) ].up;
+        if ( options_.evaluator ) {
+            // PUCT, all moves of the leaf are expanded at once, with the priors of the network,
+            // and its value (for the player to move) is backpropagated, instead of a playout.
+            float value = 0.0f;
+            if ( state.terminal ( ) ) {
+                value = state.winner ( ).vacant ( ) ? 0.0f : state.winner ( ) == state.playerToMove ( ) ? 1.0f : -1.0f;
+            }
+            else {
+                static thread_local std::vector<float> priors;
+                Node<State> const & leaf = tree[ node ( ) ];
+                // A leaf that was evaluated before, but has neither children nor moves, was frozen
+                // (by compact), or reached once expansion had stopped, it is only evaluated.
+                bool const frozen = root_node != node and leaf.data.visits > 0 and not leaf.has_untried_moves ( );
+                typename State::Moves const moves = frozen                           ? typename State::Moves{ }
+                                                    : leaf.has_untried_moves ( )     ? leaf.data.moves
+                                                    : depth < options_.symmetry_plies ? state.availableCanonicalMoves ( )
+                                                                                      : state.availableMoves ( );
+                priors.resize ( moves.size ( ) );
+                value = options_.evaluator->evaluate ( state, moves, priors.data ( ) );
+                if ( expand and not frozen ) {
+                    tree[ node ( ) ].data.moves.reset ( );
+                    for ( int i = 0; i < static_cast<int> ( moves.size ( ) ); ++i ) {
+                        NodeID const child = add_child ( tree, node, moves[ i ], state.playerToMove ( ).opponent ( ), priors[ i ] );
+                        if ( max_memory )
+                            memory += node_memory<State> ( tree[ child ( ) ] );
+                    }
+                }
+            }
+            for ( auto const player = state.playerToMove ( ); NodeID::invalid ( ) != node; node = tree[ node ( ) ].up )
+                tree[ node ( ) ].update ( 0.5f * ( 1.0f + ( tree[ node ( ) ].data.player == player ? -value : value ) ) );
+        }
+        else {
+            // If we are not already at the final state, expand the tree with a new node ( ) and Move there.
+            if ( expand and tree[ node ( ) ].has_untried_moves ( ) ) {
+                auto move = tree[ node ( ) ].get_untried_move ( random_engine );
+                state.moveWinner ( move );
+                node = add_child ( tree, node, state, move );
+                // Near the root, positions are often symmetric, only expand one move of each class of equivalent moves.
+                if ( ++depth < options_.symmetry_plies and state.nonterminal ( ) )
+                    tree[ node ( ) ].data.moves = state.availableCanonicalMoves ( );
+                if ( max_memory )
+                    memory += node_memory<State> ( tree[ node ( ) ] );
             }
+            for ( int i = 0; i < 1; ++i ) {
+                State sim_state = state;
+                // We now play randomly until the game ends (or until the cutoff).
+                int const plies = options_.playout_cutoff > 0 ? options_.playout_cutoff : std::numeric_limits<int>::max ( );
+                if ( options_.playout_threat_depth >= 0 )
+                    ThreatSpace::simulate ( sim_state, options_.playout_threat_depth, plies );
+                else
+                    sim_state.simulate ( plies );
+                // We have now reached a final state. Backpropagate the result up the tree to the root node ( ).
+                if ( sim_state.terminal ( ) ) {
+                    while ( NodeID::invalid ( ) != node ) {
+                        tree[ node ( ) ].update ( sim_state.result ( tree[ node ( ) ].data.player ) );
+                        node = tree[ node ( ) ].up;
+                    }
+                }
+                else { // Cut off, the (fractional) result is the probability of a win.
+                    float const p = StaticEval::win_probability ( sim_state, options_.evaluation );
+                    for ( auto const player = sim_state.playerToMove ( ); NodeID::invalid ( ) != node; node = tree[ node ( ) ].up )
+                        tree[ node ( ) ].update ( tree[ node ( ) ].data.player == player ? 1.0f - p : p );
+                }
+            }
+        }
+        if ( max_memory and expand and memory > max_memory ) {
+            compact ( tree );
+            memory = memory_usage ( tree );
+            expand = memory < ( max_memory - max_memory / 4 );
+            if ( options_.verbose )
+                std::cerr << "compacted to " << tree.size ( ) << " nodes (" << memory << " bytes)"
+                          << ( expand ? "." : ", expansion stopped." ) << std::endl;
         }
+        if ( options_.stop and options_.stop->load ( std::memory_order_relaxed ) )
+            break;
         if ( options_.verbose or options_.max_time >= 0 ) {
             double time = wall_time ( );
             if ( options_.verbose and ( time - print_time >= 1.0 or iter == options_.max_iterations ) ) {
                 std::cerr << iter << " games played (" << double ( iter ) / ( time - start_time ) << " / second)." << std::endl;
                 print_time = time;
             }
-            if ( time - start_time >= options_.max_time )
+            if ( options_.max_time >= 0 and time - start_time >= options_.max_time )
                 break;
         }
     }
-    // Collect and return the results.
+}
+
+// Collects the statistics of the children of the root, the statistics of the representative
+// moves are mapped back onto all the moves equivalent to them (iff the root was expanded that
+// way, a re-used tree might not have been).
+template<typename State>
+[[nodiscard]] Results<State> root_results ( Tree<State> const & tree_, State const & root_state_,
+                                            ComputeOptions const & options_ ) {
+    Tree<State> const & tree = tree_;
+    typename State::SymmetryGroup group =
+        options_.symmetry_plies > 0 ? root_state_.stabilizer ( ) : typename State::SymmetryGroup{ };
+    for ( NodeID child = tree[ root_node ( ) ].tail; group.size ( ) and NodeID::invalid ( ) != child;
+          child = tree[ child ( ) ].prev )
+        if ( State::orbit ( tree[ child ( ) ].data.move, group ).size ( ) > 1 and
+             std::any_of ( std::begin ( group ), std::end ( group ), [ m = tree[ child ( ) ].data.move ] ( int const s ) noexcept {
+                 return State::transform ( m, s ) < m;
+             } ) )
+            group.clear ( );
     Results<State> r;
-    r.reserve ( tree[ root_node ( ) ].size );
-    for ( NodeID child = tree[ root_node ( ) ].tail; NodeID::invalid ( ) != child; child = tree[ child ( ) ].prev )
-        r.emplace_back ( Result<typename State::Move>{ tree[ child ( ) ].data.visits, tree[ child ( ) ].data.wins,
-                                                       tree[ child ( ) ].data.move } );
+    r.reserve ( tree[ root_node ( ) ].size * ( static_cast<int> ( group.size ( ) ) + 1 ) );
+    for ( NodeID child = tree[ root_node ( ) ].tail; NodeID::invalid ( ) != child; child = tree[ child ( ) ].prev ) {
+        auto const & c = tree[ child ( ) ].data;
+        for ( auto const move : State::orbit ( c.move, group ) )
+            r.emplace_back ( Result<typename State::Move>{ c.visits, c.wins, move } );
+    }
     return r;
 }
 
 template<typename State>
-typename State::Move compute_move ( State const root_state_, ComputeOptions const options_ ) {
-    {
-        typename State::Moves moves = root_state_.availableMoves ( );
-        attest ( moves.size ( ) > 0 );
-        if ( 1 == moves.size ( ) )
-            return moves[ 0 ];
-    }
-    std::vector<Tree<State>> trees;
-    trees.reserve ( options_.number_of_threads );
-    for ( int t = 0; t < options_.number_of_threads; ++t ) {
-        Tree<State> tree;
-        tree.reserve ( 64 );
-        tree.emplace_back ( );
-        add_child ( tree, NodeID{ 0 }, root_state_, State::no_move ); // add root states
-        trees.emplace_back ( std::move ( tree ) );
+Results<State> compute_tree ( std::reference_wrapper<Tree<State>> tree_, State const root_state_, ComputeOptions const options_ ) {
+    search_tree ( tree_.get ( ), root_state_, options_ );
+    return root_results ( tree_.get ( ), root_state_, options_ );
+}
+
+template<typename State>
+[[nodiscard]] Tree<State> make_tree ( State const & root_state_ ) {
+    Tree<State> tree;
+    tree.reserve ( 64 );
+    tree.emplace_back ( );
+    add_child ( tree, NodeID{ 0 }, root_state_, State::no_move ); // add root states
+    return tree;
+}
+
+// Searches the (possibly non-empty) trees_, one per thread, rooted at root_state_.
+template<typename State>
+typename State::Move compute_move ( std::vector<Tree<State>> & trees_, State const & root_state_, ComputeOptions const options_ ) {
+    std::vector<Tree<State>> & trees = trees_;
+    assert ( trees.size ( ) >= static_cast<std::size_t> ( options_.number_of_threads ) );
+    if ( options_.book )
+        if ( auto const move = options_.book->probe ( root_state_ ); move.is_valid ( ) )
+            return move;
+    // A clearly decided position, does not need the full search.
+    if ( options_.threat_depth > 0 )
+        if ( auto const r = ThreatSpace::search ( root_state_, options_.threat_depth ); r.win )
+            return r.move;
+    if ( options_.solver_nodes > 0 ) {
+        ProofNumber::ComputeOptions solver_options;
+        solver_options.number_of_threads = options_.number_of_threads;
+        solver_options.max_nodes         = options_.solver_nodes;
+        solver_options.verbose           = options_.verbose;
+        if ( auto const r = ProofNumber::solve ( root_state_, solver_options ); ProofNumber::Value::proven == r.value )
+            return r.move;
     }
-    assert ( trees.size ( ) >= options_.number_of_threads );
     // Start all jobs to compute trees.
     std::vector<std::future<Results<State>>> results_futures;
     results_futures.reserve ( options_.number_of_threads );
@@ -485,51 +861,506 @@ typename State::Move compute_move ( State const root_state_, ComputeOptions cons
     results.reserve ( options_.number_of_threads );
     for ( auto & results_future : results_futures )
         results.push_back ( std::move ( results_future.get ( ) ) );
-    // Merge the results.
-    std::map<typename State::Move, std::pair<int, float>> merged_results;
-    int games_played = 0;
+    // Merge the results, into dense arrays indexed by Move::dense_index ( ).
+    using Move                   = typename State::Move;
+    constexpr int merged_size    = Move::dense_size ( );
+    static thread_local std::vector<int> merged_visits;
+    static thread_local std::vector<float> merged_wins;
+    merged_visits.assign ( merged_size, 0 ); // Only allocates on the first call.
+    merged_wins.assign ( merged_size, 0.0f );
     for ( auto & result : results ) {
         for ( auto & r : result ) {
-            auto & m = merged_results[ r.move ];
-            m.first += r.visits;
-            m.second += r.wins;
-            games_played += r.visits;
+            int const i = r.move.dense_index ( );
+            merged_visits[ i ] += r.visits;
+            merged_wins[ i ] += r.wins;
         }
     }
-    // Find the node with the highest score.
+    // Equivalent moves share their statistics, so count the games at the roots.
+    int games_played = 0;
+    for ( auto & tree : trees )
+        games_played += tree[ root_node ( ) ].data.visits;
+    // Find the move with the highest expected success rate. Unvisited moves (not at the
+    // root) are masked out. The loop is branch-free, so it vectorizes.
     float best_score = 0.0f;
-    typename State::Move best_move;
-    for ( auto & itr : merged_results ) {
-        typename State::Move move = itr.first;
-        float v = itr.second.first, w = itr.second.second;
-        // Expected success rate assuming a uniform prior (Beta(1, 1)).
-        // https://en.wikipedia.org/wiki/Beta_distribution
-        float expected_success_rate = ( w + 1.0f ) / ( v + 2.0f );
-        if ( expected_success_rate > best_score ) {
-            best_move  = move;
-            best_score = expected_success_rate;
-        }
-        if ( options_.verbose ) {
-            std::cerr << "Move: " << itr.first << " (" << std::setw ( 2 ) << std::right
+    int best_index   = 0;
+    for ( int i = 0; i < merged_size; ++i ) {
+        float const v     = static_cast<float> ( merged_visits[ i ] );
+        float const score = expected_success_rate ( merged_wins[ i ], v, options_.constants.final_prior_wins,
+                                                    options_.constants.final_prior_losses );
+        bool const better = v > 0.0f and score > best_score;
+        best_score        = better ? score : best_score;
+        best_index        = better ? i : best_index;
+    }
+    Move const best_move = Move::from_dense_index ( best_index );
+    if ( options_.verbose ) {
+        for ( int i = 0; i < merged_size; ++i ) {
+            if ( not merged_visits[ i ] )
+                continue;
+            float const v = static_cast<float> ( merged_visits[ i ] ), w = merged_wins[ i ];
+            std::cerr << "Move: " << Move::from_dense_index ( i ) << " (" << std::setw ( 2 ) << std::right
                       << int ( 100.0f * v / float ( games_played ) + 0.5f ) << "% visits)"
                       << " (" << std::setw ( 2 ) << std::right << int ( 100.0f * w / v + 0.5f ) << "% wins)" << std::endl;
         }
-    }
-    if ( options_.verbose ) {
-        int best_visits = merged_results[ best_move ].first;
-        float best_wins = merged_results[ best_move ].second;
+        int best_visits = merged_visits[ best_index ];
+        float best_wins = merged_wins[ best_index ];
         std::cerr << "----" << std::endl;
         std::cerr << "Best: " << best_move << " (" << 100.0f * best_visits / float ( games_played ) << "% visits)"
                   << " (" << 100.0f * best_wins / best_visits << "% wins)" << std::endl;
-    }
-    if ( options_.verbose ) {
-        float time = wall_time ( );
+        double time = wall_time ( );
         std::cerr << games_played << " games played in " << float ( time - start_time ) << " s. "
                   << "(" << float ( games_played ) / ( time - start_time ) << " / second, " << options_.number_of_threads
                   << " parallel jobs)." << std::endl;
     }
     return best_move;
 }
+
+template<typename State>
+typename State::Move compute_move ( State const root_state_, ComputeOptions const options_ ) {
+    {
+        typename State::Moves moves = root_state_.availableMoves ( );
+        attest ( moves.size ( ) > 0 );
+        if ( 1 == moves.size ( ) )
+            return moves[ 0 ];
+    }
+    std::vector<Tree<State>> trees;
+    trees.reserve ( options_.number_of_threads );
+    for ( int t = 0; t < options_.number_of_threads; ++t )
+        trees.emplace_back ( make_tree ( root_state_ ) );
+    return compute_move ( trees, root_state_, options_ );
+}
+
+// Builds an opening book of the positions after fewer than plies_ moves, one of every class
+// of symmetric positions, every position is searched with options_ (deeply, with all
+// threads), concurrency_ positions at a time.
+template<typename State>
+void build_book ( std::filesystem::path const & path_, int const plies_, ComputeOptions options_, int const concurrency_ = 1 ) {
+    std::vector<State> positions, frontier ( 1 );
+    std::set<typename State::ZobristHash> seen;
+    for ( int ply = 0; ply < plies_; ++ply ) {
+        std::vector<State> next;
+        for ( auto const & state : frontier ) {
+            int symmetry = 0;
+            if ( state.terminal ( ) or not seen.insert ( state.canonicalZobrist ( symmetry ) ).second )
+                continue;
+            positions.push_back ( state );
+            for ( auto const move : state.availableCanonicalMoves ( ) ) {
+                next.push_back ( state );
+                next.back ( ).moveHashWinner ( move );
+            }
+        }
+        frontier = std::move ( next );
+    }
+    bool const verbose = options_.verbose;
+    options_.verbose   = false;
+    options_.book      = nullptr;
+    std::vector<Book::Entry> entries ( positions.size ( ) );
+    std::atomic<std::size_t> next{ 0u };
+    auto work = [ & ] ( ) {
+        for ( std::size_t i; ( i = next.fetch_add ( 1u, std::memory_order_relaxed ) ) < positions.size ( ); ) {
+            State const & state = positions[ i ];
+            std::vector<Tree<State>> trees;
+            for ( int t = 0; t < options_.number_of_threads; ++t )
+                trees.emplace_back ( make_tree ( state ) );
+            auto const move = compute_move ( trees, state, options_ );
+            Result<typename State::Move> stats;
+            for ( auto const & tree : trees )
+                for ( auto const & r : root_results ( tree, state, options_ ) )
+                    if ( r.move == move ) {
+                        stats.visits += r.visits;
+                        stats.wins += r.wins;
+                    }
+            // Without visits, the move was proven (a win) by the threat space search, or the
+            // solver, before the trees were searched.
+            bool const proven = 0 == stats.visits;
+            int symmetry      = 0;
+            Book::Entry & e   = entries[ i ];
+            e.key             = state.canonicalZobrist ( symmetry );
+            e.move            = static_cast<std::uint16_t> ( State::transform ( move, symmetry ).dense_index ( ) );
+            e.visits          = proven ? std::numeric_limits<std::uint32_t>::max ( ) : static_cast<std::uint32_t> ( stats.visits );
+            e.wins            = static_cast<std::uint16_t> ( proven ? 65535.0f : 65535.0f * stats.wins / stats.visits + 0.5f );
+            if ( verbose )
+                std::cerr << "book " << i + 1 << '/' << positions.size ( ) << ' ' << move << std::endl;
+        }
+    };
+    std::vector<std::thread> threads;
+    for ( int t = 1; t < concurrency_; ++t )
+        threads.emplace_back ( work );
+    work ( );
+    for ( auto & thread : threads )
+        thread.join ( );
+    Book::save ( std::move ( entries ), State::Board::radius ( ), path_ );
+}
+
+// A snapshot of the trees (of the threads) of a search, and its root position, a single
+// image, so long analyses can be resumed (or moved to another machine) without starting
+// afresh. The nodes and the moves are in their wire layouts (Wire::Layout).
+//
+// | header 64 | nodes per tree ( trees ) x 8 | nodes | moves | root position |, the moves
+// of the nodes in order.
+struct SnapshotHeader {
+    char magic[ 8 ]                      = { 'M', 'A', 'D', 'O', 'T', 'R', 'E', '\0' };
+    Wire::Little<std::uint32_t> version  = 1u;
+    Wire::Little<std::uint32_t> radius   = 0u;
+    Wire::Little<std::uint64_t> trees    = 0u;
+    Wire::Little<std::uint64_t> nodes    = 0u;
+    Wire::Little<std::uint64_t> moves    = 0u;
+    Wire::Little<std::uint32_t> node     = 0u; // the version of the layout of a node.
+    Wire::Little<std::uint32_t> move     = 0u; // of a move.
+    Wire::Little<std::uint32_t> position = 0u; // of a position.
+    std::uint8_t reserved[ 12 ]          = { };
+};
+
+static_assert ( sizeof ( SnapshotHeader ) == 64, "the header is 64 bytes" );
+
+template<typename State>
+void save_snapshot ( std::vector<Tree<State>> const & trees_, State const & root_state_, std::filesystem::path const & path_ ) {
+    using NodeLayout     = Wire::Layout<Node<State>>;
+    using MoveLayout     = Wire::Layout<typename State::Move>;
+    using PositionLayout = Wire::Layout<typename State::PositionData>;
+    std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+    if ( not ostream )
+        throw std::runtime_error ( "Snapshot: cannot write " + path_.string ( ) );
+    SnapshotHeader header;
+    header.radius   = static_cast<std::uint32_t> ( State::Board::radius ( ) );
+    header.trees    = static_cast<std::uint64_t> ( trees_.size ( ) );
+    header.node     = NodeLayout::version;
+    header.move     = MoveLayout::version;
+    header.position = PositionLayout::version;
+    std::uint64_t nodes = 0u, moves = 0u;
+    std::vector<Wire::Little<std::uint64_t>> sizes;
+    for ( auto const & tree : trees_ ) {
+        sizes.emplace_back ( static_cast<std::uint64_t> ( tree.size ( ) ) );
+        nodes += static_cast<std::uint64_t> ( tree.size ( ) );
+        for ( auto const & node : tree )
+            moves += node.data.moves.size ( );
+    }
+    header.nodes = nodes;
+    header.moves = moves;
+    ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( SnapshotHeader ) );
+    ostream.write ( reinterpret_cast<char const *> ( sizes.data ( ) ),
+                    static_cast<std::streamsize> ( sizes.size ( ) * sizeof ( std::uint64_t ) ) );
+    // The records are packed in chunks, and written in bulk.
+    std::vector<typename NodeLayout::type> node_chunk;
+    node_chunk.reserve ( 4'096u );
+    auto write_nodes = [ & ] ( ) {
+        ostream.write ( reinterpret_cast<char const *> ( node_chunk.data ( ) ),
+                        static_cast<std::streamsize> ( node_chunk.size ( ) * sizeof ( typename NodeLayout::type ) ) );
+        node_chunk.clear ( );
+    };
+    for ( auto const & tree : trees_ )
+        for ( auto const & node : tree ) {
+            node_chunk.push_back ( NodeLayout::pack ( node ) );
+            if ( node_chunk.size ( ) == node_chunk.capacity ( ) )
+                write_nodes ( );
+        }
+    write_nodes ( );
+    std::vector<typename MoveLayout::type> move_chunk;
+    for ( auto const & tree : trees_ )
+        for ( auto const & node : tree ) {
+            for ( int i = 0; i < static_cast<int> ( node.data.moves.size ( ) ); ++i )
+                move_chunk.push_back ( MoveLayout::pack ( node.data.moves[ i ] ) );
+            if ( move_chunk.size ( ) >= 16'384u ) {
+                ostream.write ( reinterpret_cast<char const *> ( move_chunk.data ( ) ),
+                                static_cast<std::streamsize> ( move_chunk.size ( ) * sizeof ( typename MoveLayout::type ) ) );
+                move_chunk.clear ( );
+            }
+        }
+    ostream.write ( reinterpret_cast<char const *> ( move_chunk.data ( ) ),
+                    static_cast<std::streamsize> ( move_chunk.size ( ) * sizeof ( typename MoveLayout::type ) ) );
+    typename PositionLayout::type const position = PositionLayout::pack ( root_state_.position ( ) );
+    ostream.write ( reinterpret_cast<char const *> ( &position ), sizeof ( position ) );
+    ostream.close ( );
+    if ( not ostream )
+        throw std::runtime_error ( "Snapshot: cannot write " + path_.string ( ) );
+}
+
+// Restores the trees of a snapshot, memory mapped, the nodes are unpacked (copied) out of
+// the mapping, their moves copied in bulk. Returns the root position. Nothing in the file
+// is trusted, the sizes, and the ids and the moves of every node, are checked.
+template<typename State>
+typename State::PositionData load_snapshot ( std::vector<Tree<State>> & trees_, std::filesystem::path const & path_ ) {
+    using NodeLayout     = Wire::Layout<Node<State>>;
+    using MoveLayout     = Wire::Layout<typename State::Move>;
+    using PositionLayout = Wire::Layout<typename State::PositionData>;
+    MappedFile const file ( path_ );
+    SnapshotHeader header, expected;
+    if ( file.size ( ) < sizeof ( SnapshotHeader ) )
+        throw std::runtime_error ( "Snapshot: not a snapshot " + path_.string ( ) );
+    std::memcpy ( &header, file.data ( ), sizeof ( SnapshotHeader ) );
+    if ( std::memcmp ( header.magic, expected.magic, sizeof ( header.magic ) ) or expected.version != header.version or
+         State::Board::radius ( ) != static_cast<int> ( header.radius ) or NodeLayout::version != header.node or
+         MoveLayout::version != header.move or PositionLayout::version != header.position )
+        throw std::runtime_error ( "Snapshot: wrong snapshot " + path_.string ( ) );
+    std::uint64_t const trees = header.trees, nodes = header.nodes, moves = header.moves;
+    // The regions are taken off the rest of the file one by one, so nothing overflows.
+    std::uint64_t rest = file.size ( ) - sizeof ( SnapshotHeader );
+    auto take          = [ &rest ] ( std::uint64_t const count_, std::uint64_t const size_ ) noexcept {
+        if ( count_ > rest / size_ )
+            return false;
+        rest -= count_ * size_;
+        return true;
+    };
+    if ( not take ( trees, sizeof ( std::uint64_t ) ) or not take ( nodes, sizeof ( typename NodeLayout::type ) ) or
+         not take ( moves, sizeof ( typename MoveLayout::type ) ) or not take ( 1u, sizeof ( typename PositionLayout::type ) ) )
+        throw std::runtime_error ( "Snapshot: truncated snapshot " + path_.string ( ) );
+    auto corrupt = [ &path_ ] ( ) { return std::runtime_error ( "Snapshot: corrupt snapshot " + path_.string ( ) ); };
+    auto const * const sizes = reinterpret_cast<Wire::Little<std::uint64_t> const *> ( file.data ( ) + sizeof ( SnapshotHeader ) );
+    std::uint64_t total      = 0u;
+    for ( std::uint64_t t = 0u; t < trees; ++t ) {
+        std::uint64_t const size = sizes[ t ];
+        if ( size > nodes - total or size > static_cast<std::uint64_t> ( std::numeric_limits<int>::max ( ) ) )
+            throw corrupt ( );
+        total += size;
+    }
+    if ( nodes != total )
+        throw corrupt ( );
+    auto const * node      = reinterpret_cast<typename NodeLayout::type const *> ( sizes + trees );
+    auto const * move      = reinterpret_cast<typename MoveLayout::type const *> ( node + nodes );
+    auto const * const end = move + moves;
+    trees_.clear ( );
+    trees_.reserve ( static_cast<std::size_t> ( trees ) );
+    for ( std::uint64_t t = 0u; t < trees; ++t ) {
+        Tree<State> & tree = trees_.emplace_back ( );
+        int const n_size   = static_cast<int> ( static_cast<std::uint64_t> ( sizes[ t ] ) );
+        // An id is of a node of this tree, or invalid.
+        auto valid = [ n_size ] ( std::int32_t const id_ ) noexcept {
+            return NODEID_INVALID_VALUE == id_ or ( 0 <= id_ and id_ < n_size );
+        };
+        tree.reserve ( n_size );
+        for ( int n = 0; n < n_size; ++n, ++node ) {
+            std::int32_t const size = node->moves;
+            if ( not valid ( node->up ) or not valid ( node->prev ) or not valid ( node->tail ) or node->size < 0 or size < -1 or
+                 size > static_cast<std::int32_t> ( 2 * State::Board::size ( ) ) or end - move < size )
+                throw corrupt ( );
+            Node<State> & rebuilt = tree.emplace_back ( );
+            NodeLayout::unpack ( *node, rebuilt );
+            if ( size > 0 ) {
+                if constexpr ( MoveLayout::identity ) {
+                    std::memcpy ( static_cast<void *> ( &rebuilt.data.moves[ 0 ] ), move, size * sizeof ( typename State::Move ) );
+                }
+                else {
+                    for ( int i = 0; i < size; ++i )
+                        MoveLayout::unpack ( move[ i ], rebuilt.data.moves[ i ] );
+                }
+                move += size;
+            }
+        }
+    }
+    typename State::PositionData position;
+    PositionLayout::unpack ( *reinterpret_cast<typename PositionLayout::type const *> ( end ), position );
+    return position;
+}
+
+// Searches on the opponent's time. After the agent has moved, start ( ) keeps searching
+// the position with the opponent to move, i.e. all of the opponent's replies. Once the
+// opponent has moved, compute_move ( ) stops that, keeps the sub-trees of the reply
+// that was played, and resumes searching from there, with all statistics retained.
+//
+//     Ponder<State> ponder ( options );
+//     state.move ( ponder.compute_move ( state ) ); // agent
+//     ponder.start ( state );
+//     state.move ( ... );                            // opponent
+//
+// Pondering is only bounded by memory, so setting options.max_memory is recommended.
+template<typename State>
+class Ponder {
+
+    public:
+    using Move = typename State::Move;
+
+    explicit Ponder ( ComputeOptions const & options_ = ComputeOptions{ } ) : m_options ( options_ ), m_stop ( false ) {
+        m_options.number_of_threads = std::max ( m_options.number_of_threads, 1 );
+    }
+    Ponder ( Ponder const & ) = delete;
+    Ponder ( Ponder && )      = delete;
+
+    ~Ponder ( ) noexcept { stop ( ); }
+
+    Ponder & operator= ( Ponder const & ) = delete;
+    Ponder & operator= ( Ponder && ) = delete;
+
+    // Stops pondering, and returns the best move in state_, state_ is the state of the
+    // last call (to either member function) plus one move, or a new game.
+    [[nodiscard]] Move compute_move ( State const & state_ ) {
+        stop ( );
+        advance ( state_ );
+        {
+            typename State::Moves moves = state_.availableMoves ( );
+            attest ( moves.size ( ) > 0 );
+            if ( 1 == moves.size ( ) )
+                return moves[ 0 ];
+        }
+        return Mcts::compute_move ( m_trees, m_state, m_options );
+    }
+
+    // Starts pondering on state_ in the background, iff the game is not over.
+    void start ( State const & state_ ) {
+        stop ( );
+        advance ( state_ );
+        if ( m_state.terminal ( ) )
+            return;
+        m_ponder_options                = m_options;
+        m_ponder_options.max_iterations = -1;
+        m_ponder_options.max_time       = -1.0f;
+        m_ponder_options.stop           = std::addressof ( m_stop );
+        m_ponder_options.verbose        = false;
+        for ( int t = 0; t < m_options.number_of_threads; ++t )
+            m_jobs.push_back ( std::async ( std::launch::async, [ t, this ] ( ) {
+                search_tree ( m_trees[ t ], m_state, m_ponder_options );
+            } ) );
+    }
+
+    // Stops pondering, and saves the trees (see save_snapshot ( )), to be resumed by
+    // load ( ) and start ( ), e.g. after a restart.
+    void save ( std::filesystem::path const & path_ ) {
+        stop ( );
+        save_snapshot ( m_trees, m_state, path_ );
+    }
+
+    // Stops pondering, and restores the trees of a snapshot of state_, or returns false,
+    // iff the snapshot is of another position.
+    [[nodiscard]] bool load ( std::filesystem::path const & path_, State const & state_ ) {
+        stop ( );
+        std::vector<Tree<State>> trees;
+        if ( load_snapshot ( trees, path_ ) != state_.position ( ) )
+            return false;
+        while ( static_cast<int> ( trees.size ( ) ) < m_options.number_of_threads )
+            trees.emplace_back ( make_tree ( state_ ) );
+        m_trees = std::move ( trees );
+        m_state = state_;
+        return true;
+    }
+
+    // Stops pondering, waits for the search threads to finish.
+    void stop ( ) noexcept {
+        m_stop.store ( true, std::memory_order_relaxed );
+        for ( auto & job : m_jobs )
+            job.wait ( );
+        m_jobs.clear ( );
+        m_stop.store ( false, std::memory_order_relaxed );
+    }
+
+    private:
+    // Moves the roots of the trees to state_, keeping the sub-trees, iff state_ is, or
+    // follows by one move from, the current root state, and starts afresh otherwise.
+    void advance ( State const & state_ ) {
+        if ( m_trees.size ( ) and m_state.move_no == state_.move_no and m_state.position ( ) == state_.position ( ) ) {
+            m_state = state_; // The same position, e.g. after load ( ).
+            return;
+        }
+        bool keep = m_trees.size ( ) and m_state.nonterminal ( ) and m_state.move_no + 1 == state_.move_no;
+        if ( keep ) {
+            State state = m_state;
+            state.moveWinner ( state_.lastMove ( ) );
+            keep = state.position ( ) == state_.position ( );
+        }
+        for ( auto & tree : m_trees )
+            keep = keep and reroot ( tree, m_state, state_.lastMove ( ) ) and
+                   ( tree[ root_node ( ) ].has_children ( ) or tree[ root_node ( ) ].has_untried_moves ( ) );
+        m_state = state_;
+        if ( keep )
+            return;
+        m_trees.clear ( );
+        for ( int t = 0; t < m_options.number_of_threads; ++t )
+            m_trees.emplace_back ( make_tree ( m_state ) );
+    }
+
+    ComputeOptions m_options, m_ponder_options;
+    std::vector<Tree<State>> m_trees;
+    State m_state;
+    std::atomic<bool> m_stop;
+    std::vector<std::future<void>> m_jobs;
+};
+
+// A search driven by the caller, in steps, that can be queried in between, e.g. a few
+// iterations per frame of the UI:
+//
+//     SearchSession<State> session;
+//     session.start ( state, options );
+//     while ( session.is_running ( ) and ... ) {
+//         session.step ( 256 );
+//         show ( session.best_so_far ( ), session.root_stats ( ) );
+//     }
+//     session.stop ( );
+//
+// or, as a coroutine, that suspends after every step and yields the best move so far:
+//
+//     auto steps = session.run ( 256 );
+//     while ( steps.next ( ) )
+//         show ( steps.value ( ) );
+//
+// The search runs on the calling thread, the number of threads, the maximum number of
+// iterations and the maximum time of the options are ignored, the caller decides.
+template<typename State>
+class SearchSession {
+
+    public:
+    using Move = typename State::Move;
+
+    // Starts a new search of state_, the results of the previous search are discarded.
+    void start ( State const & state_, ComputeOptions const & options_ = ComputeOptions{ } ) {
+        m_state                     = state_;
+        m_options                   = options_;
+        m_options.number_of_threads = 1;
+        m_options.max_time          = -1.0f;
+        m_options.stop              = nullptr;
+        m_options.verbose           = false;
+        m_tree                      = make_tree ( m_state );
+        m_iterations                = 0;
+        m_running                   = m_state.nonterminal ( );
+    }
+
+    // Runs n_ iterations, returns the number of iterations run (0, iff not running).
+    int step ( int const n_ ) {
+        if ( not m_running or n_ <= 0 )
+            return 0;
+        m_options.max_iterations = n_;
+        search_tree ( m_tree, m_state, m_options );
+        m_iterations += n_;
+        return n_;
+    }
+
+    // The move with the highest expected success rate, no_move before the first step.
+    [[nodiscard]] Move best_so_far ( ) const noexcept {
+        Move best_move   = State::no_move;
+        float best_score = 0.0f;
+        if ( m_tree.size ( ) )
+            for ( NodeID child = m_tree[ root_node ( ) ].tail; NodeID::invalid ( ) != child; child = m_tree[ child ( ) ].prev )
+                if ( float const score = expected_success_rate (
+                         m_tree[ child ( ) ].data.wins, static_cast<float> ( m_tree[ child ( ) ].data.visits ),
+                         m_options.constants.final_prior_wins, m_options.constants.final_prior_losses );
+                     score > best_score ) {
+                    best_move  = m_tree[ child ( ) ].data.move;
+                    best_score = score;
+                }
+        return best_move;
+    }
+
+    // The statistics of all moves at the root.
+    [[nodiscard]] Results<State> root_stats ( ) const {
+        return m_tree.size ( ) ? root_results ( m_tree, m_state, m_options ) : Results<State>{ };
+    }
+
+    // Ends the search, it can still be queried, until the next start ( ).
+    void stop ( ) noexcept { m_running = false; }
+
+    [[nodiscard]] bool is_running ( ) const noexcept { return m_running; }
+    [[nodiscard]] std::int64_t iterations ( ) const noexcept { return m_iterations; }
+
+#if defined( __cpp_impl_coroutine ) or defined( __cpp_coroutines )
+    [[nodiscard]] Generator<Move> run ( int const n_ ) {
+        while ( step ( n_ ) )
+            co_yield best_so_far ( );
+    }
+#endif
+
+    private:
+    ComputeOptions m_options;
+    Tree<State> m_tree;
+    State m_state;
+    std::int64_t m_iterations = 0;
+    bool m_running            = false;
+};
 #else
 // This class is used to build the game tree. The root is created by the users and
 // the rest of the tree is created by add_node.
@@ -777,3 +1608,54 @@ inline void assertion_failed ( char const * expr, char const * file_cstr, int li
 }
 
 } // namespace Mcts
+
+// The node, but for its moves (their number is in the record, -1 if released), which are
+// stored apart, as a span of moves.
+template<typename State>
+struct Wire::Layout<Mcts::Node<State>> {
+
+    using Node = Mcts::Node<State>;
+
+    struct type {
+        Little<std::int32_t> up, prev, tail, size;
+        Little<std::int32_t> visits;
+        Little<float> wins, prior;
+        Little<std::int32_t> moves;
+        typename Layout<typename Node::Move>::type move;
+        typename Layout<typename Node::Player>::type player;
+    };
+
+    static_assert ( alignof ( type ) == 1, "a node is unaligned bytes" );
+
+    static constexpr std::uint32_t version = 1u;
+    static constexpr bool identity         = false;
+
+    [[nodiscard]] static type pack ( Node const & n_ ) noexcept {
+        type t;
+        t.up     = n_.up.id;
+        t.prev   = n_.prev.id;
+        t.tail   = n_.tail.id;
+        t.size   = n_.size;
+        t.visits = n_.data.visits;
+        t.wins   = n_.data.wins;
+        t.prior  = n_.data.prior;
+        t.moves  = n_.data.moves.is_released ( ) ? std::int32_t{ -1 } : static_cast<std::int32_t> ( n_.data.moves.size ( ) );
+        t.move   = Layout<typename Node::Move>::pack ( n_.data.move );
+        t.player = Layout<typename Node::Player>::pack ( n_.data.player );
+        return t;
+    }
+    // The moves are resized, not read.
+    static void unpack ( type const & t_, Node & n_ ) noexcept {
+        n_.up.id       = t_.up;
+        n_.prev.id     = t_.prev;
+        n_.tail.id     = t_.tail;
+        n_.size        = t_.size;
+        n_.data.visits = t_.visits;
+        n_.data.wins   = t_.wins;
+        n_.data.prior  = t_.prior;
+        if ( std::int32_t const moves = t_.moves; moves > 0 )
+            n_.data.moves.resize ( moves );
+        Layout<typename Node::Move>::unpack ( t_.move, n_.data.move );
+        Layout<typename Node::Player>::unpack ( t_.player, n_.data.player );
+    }
+};
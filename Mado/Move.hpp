@@ -39,6 +39,7 @@
 #include "../../compact_vector/include/compact_vector.hpp"
 
 #include "Hexcontainer.hpp"
+#include "Wire.hpp"
 
 template<int R>
 struct Move {
@@ -54,8 +55,8 @@ struct Move {
     }
 
     [[nodiscard]] bool operator== ( Move const & rhs_ ) const noexcept {
-        using uint = std::conditional_t<sizeof ( value_type ) == 8, std::uint16_t,
-                                        std::conditional_t<sizeof ( value_type ) == 16, std::uint32_t, std::uint64_t>>;
+        using uint = std::conditional_t<sizeof ( value_type ) == 1, std::uint16_t,
+                                        std::conditional_t<sizeof ( value_type ) == 2, std::uint32_t, std::uint64_t>>;
         uint l;
         std::memcpy ( std::addressof ( l ), this, sizeof ( uint ) );
         uint r;
@@ -83,6 +84,17 @@ struct Move {
 
     void invalidate ( ) noexcept { to = std::numeric_limits<value_type>::lowest ( ); }
 
+    // A dense (perfect) index of all valid moves, to * size + from, a placement is encoded as from == to.
+    [[nodiscard]] static constexpr int dense_size ( ) noexcept { return Hex<R, true>::size ( ) * Hex<R, true>::size ( ); }
+    [[nodiscard]] constexpr int dense_index ( ) const noexcept {
+        return static_cast<int> ( to ) * Hex<R, true>::size ( ) + static_cast<int> ( is_placement ( ) ? to : from );
+    }
+    [[nodiscard]] static constexpr Move from_dense_index ( int const i_ ) noexcept {
+        value_type const to = static_cast<value_type> ( i_ / Hex<R, true>::size ( ) ),
+                         from = static_cast<value_type> ( i_ % Hex<R, true>::size ( ) );
+        return from == to ? Move{ to } : Move{ from, to };
+    }
+
     template<typename Stream>
     [[maybe_unused]] friend Stream & operator<< ( Stream & out_, Move const & m_ ) noexcept {
         out_ << std::dec;
@@ -105,6 +117,27 @@ struct Move {
     }
 };
 
+template<int R>
+struct Wire::Layout<Move<R>> {
+
+    using value_type = typename Move<R>::value_type;
+
+    struct type {
+        Little<value_type> to, from;
+    };
+
+    static_assert ( sizeof ( type ) == 2 * sizeof ( value_type ) and alignof ( type ) == 1, "a move is 2 cells" );
+
+    static constexpr std::uint32_t version = 1u;
+    static constexpr bool identity         = little_endian or 1 == sizeof ( value_type ); // to, from, no padding.
+
+    [[nodiscard]] static type pack ( Move<R> const & m_ ) noexcept { return { m_.to, m_.from }; }
+    static void unpack ( type const & t_, Move<R> & m_ ) noexcept {
+        m_.to   = t_.to;
+        m_.from = t_.from;
+    }
+};
+
 template<std::size_t R, std::size_t BoardSize>
 // using Moves = std::vector<Move<R>>;
 using Moves = sax::compact_vector<Move<R>, int, 2 * BoardSize, BoardSize / 2>;
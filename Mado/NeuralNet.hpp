@@ -0,0 +1,448 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A small policy and value network, evaluated on the CPU. The layers are convolutions
+// over the hexagonal board, with Board::neighbors as the stencil: a cell sees itself
+// and the sum of its neighbors, with separate weights. This makes the network
+// invariant under the 12 symmetries of the board, and independent of its radius, the
+// same weights play on any board.
+//
+//   input:  8 features per cell (own stone, opponent stone, vacant, edges, slides, 1)
+//   trunk:  layers x hex convolution, channels wide, ReLU
+//   policy: 3 logits per cell (place on, slide from, slide to), a slide is from + to
+//   value:  mean over the cells, dense value_hidden ReLU, dense 1, tanh
+//
+// The Evaluator batches the positions of all search threads, a thread that finds a full
+// batch (or has waited long enough) runs it for all of them.
+
+#pragma once
+
+#include <cassert>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <chrono>
+#include <condition_variable>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <random>
+#include <stdexcept>
+#include <vector>
+
+#if defined( __AVX2__ ) and defined( __FMA__ )
+#    include <immintrin.h>
+#endif
+
+#include "MappedFile.hpp"
+
+namespace NeuralNet {
+
+// The width of an AVX2 register, in floats, all widths are a multiple of it.
+inline constexpr int lanes          = 8;
+inline constexpr int input_channels = 8;
+inline constexpr int policy_outputs = 3;
+
+// | magic 8 | version 4 | channels 4 | layers 4 | value_hidden 4 | reserved 40 |, followed by
+// the weights (little endian floats), every array starts at a multiple of 32 bytes:
+//
+//   per layer:  w [ 2 * in ][ channels ], b [ channels ], in is input_channels for the first
+//   policy:     w [ channels ][ lanes ], b [ lanes ]
+//   value:      w [ channels ][ value_hidden ], b [ value_hidden ], w [ value_hidden ], b [ lanes ]
+struct Header {
+    char magic[ 8 ]             = { 'M', 'A', 'D', 'O', 'N', 'E', 'T', '\0' };
+    std::uint32_t version       = 1u;
+    std::uint32_t channels      = 32u;
+    std::uint32_t layers        = 6u;
+    std::uint32_t value_hidden  = 32u;
+    std::uint8_t reserved[ 40 ] = { };
+};
+
+static_assert ( sizeof ( Header ) == 64, "the weights have to start at a 64 byte boundary" );
+
+class Weights {
+
+    public:
+    struct Dense {
+        float const * w;
+        float const * b;
+        int in, out;
+    };
+
+    // Memory mapped, the weights are used in place.
+    explicit Weights ( std::filesystem::path const & path_ ) : m_file ( path_ ) {
+        Header expected;
+        if ( m_file.size ( ) < sizeof ( Header ) )
+            throw std::runtime_error ( "NeuralNet: not a network " + path_.string ( ) );
+        std::memcpy ( &m_header, m_file.data ( ), sizeof ( Header ) );
+        if ( std::memcmp ( m_header.magic, expected.magic, sizeof ( m_header.magic ) ) or expected.version != m_header.version or
+             not valid ( m_header ) or m_file.size ( ) < sizeof ( Header ) + floats ( m_header ) * sizeof ( float ) )
+            throw std::runtime_error ( "NeuralNet: wrong network " + path_.string ( ) );
+        bind ( reinterpret_cast<float const *> ( m_file.data ( ) + sizeof ( Header ) ) );
+    }
+
+    // Random (He initialized) weights, for a network to be trained.
+    Weights ( int const channels_, int const layers_, int const value_hidden_, std::uint64_t const seed_ ) {
+        m_header.channels     = static_cast<std::uint32_t> ( channels_ );
+        m_header.layers       = static_cast<std::uint32_t> ( layers_ );
+        m_header.value_hidden = static_cast<std::uint32_t> ( value_hidden_ );
+        if ( not valid ( m_header ) )
+            throw std::runtime_error ( "NeuralNet: the widths have to be a positive multiple of 8" );
+        m_buffer.resize ( floats ( m_header ), 0.0f );
+        bind ( m_buffer.data ( ) );
+        std::mt19937_64 engine ( seed_ );
+        auto init = [ & ] ( Dense const & d_, float const fan_in_ ) {
+            std::normal_distribution<float> distribution ( 0.0f, std::sqrt ( 2.0f / fan_in_ ) );
+            float * w = m_buffer.data ( ) + ( d_.w - m_buffer.data ( ) );
+            for ( int i = 0; i < d_.in * d_.out; ++i )
+                w[ i ] = distribution ( engine );
+        };
+        // A cell sums itself and up to 6 neighbors.
+        for ( auto const & layer : m_layers )
+            init ( layer, 3.5f * static_cast<float> ( layer.in ) );
+        init ( m_policy, 100.0f * static_cast<float> ( m_policy.in ) );
+        init ( m_value_hidden, static_cast<float> ( m_value_hidden.in ) );
+        init ( m_value, 100.0f * static_cast<float> ( m_value.in ) );
+    }
+
+    Weights ( Weights const & ) = delete;
+    Weights & operator= ( Weights const & ) = delete;
+
+    void save ( std::filesystem::path const & path_ ) const {
+        std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+        if ( not ostream )
+            throw std::runtime_error ( "NeuralNet: cannot write " + path_.string ( ) );
+        ostream.write ( reinterpret_cast<char const *> ( &m_header ), sizeof ( Header ) );
+        ostream.write ( reinterpret_cast<char const *> ( m_data ),
+                        static_cast<std::streamsize> ( floats ( m_header ) * sizeof ( float ) ) );
+    }
+
+    [[nodiscard]] int channels ( ) const noexcept { return static_cast<int> ( m_header.channels ); }
+    [[nodiscard]] std::vector<Dense> const & layers ( ) const noexcept { return m_layers; }
+    [[nodiscard]] Dense const & policy ( ) const noexcept { return m_policy; }
+    [[nodiscard]] Dense const & value_hidden ( ) const noexcept { return m_value_hidden; }
+    [[nodiscard]] Dense const & value ( ) const noexcept { return m_value; }
+
+    private:
+    [[nodiscard]] static bool valid ( Header const & h_ ) noexcept {
+        return h_.channels and h_.layers and h_.value_hidden and not( h_.channels % lanes ) and not( h_.value_hidden % lanes ) and
+               h_.channels <= 1'024u and h_.layers <= 256u and h_.value_hidden <= 1'024u;
+    }
+
+    [[nodiscard]] static std::size_t floats ( Header const & h_ ) noexcept {
+        std::size_t const c = h_.channels, h = h_.value_hidden;
+        return ( 2 * input_channels * c + c ) + ( h_.layers - 1 ) * ( 2 * c * c + c ) + ( c * lanes + lanes ) + ( c * h + h ) +
+               ( h + lanes );
+    }
+
+    void bind ( float const * data_ ) {
+        m_data   = data_;
+        int in   = input_channels;
+        int c    = channels ( );
+        auto add = [ & ] ( int const in_, int const out_, int const b_ ) {
+            Dense const d{ data_, data_ + in_ * out_, in_, out_ };
+            data_ += in_ * out_ + b_;
+            return d;
+        };
+        m_layers.clear ( );
+        for ( std::uint32_t l = 0; l < m_header.layers; ++l, in = c )
+            m_layers.push_back ( add ( 2 * in, c, c ) );
+        int const h    = static_cast<int> ( m_header.value_hidden );
+        m_policy       = add ( c, lanes, lanes );
+        m_value_hidden = add ( c, h, h );
+        m_value        = add ( h, 1, lanes );
+    }
+
+    Header m_header;
+    MappedFile m_file;
+    std::vector<float> m_buffer;
+    float const * m_data = nullptr;
+    std::vector<Dense> m_layers;
+    Dense m_policy, m_value_hidden, m_value;
+};
+
+enum class Kernel { reference, avx2 };
+
+#if defined( __AVX2__ ) and defined( __FMA__ )
+inline constexpr Kernel default_kernel = Kernel::avx2;
+#else
+inline constexpr Kernel default_kernel = Kernel::reference;
+#endif
+
+// y = b + x W, optionally rectified, x of d_.in, y of d_.out floats. The reference kernel
+// sums in a fixed order, so it gives the same results everywhere.
+inline void dense_reference ( Weights::Dense const & d_, float const * x_, float * y_, bool const relu_ ) noexcept {
+    for ( int o = 0; o < d_.out; ++o ) {
+        float s = d_.b[ o ];
+        for ( int i = 0; i < d_.in; ++i )
+            s += x_[ i ] * d_.w[ i * d_.out + o ];
+        y_[ o ] = relu_ ? std::max ( s, 0.0f ) : s;
+    }
+}
+
+#if defined( __AVX2__ ) and defined( __FMA__ )
+// As dense_reference ( ), d_.out a multiple of lanes, 4 registers of outputs at a time.
+inline void dense_avx2 ( Weights::Dense const & d_, float const * x_, float * y_, bool const relu_ ) noexcept {
+    __m256 const zero = _mm256_setzero_ps ( );
+    int o             = 0;
+    for ( ; o + 4 * lanes <= d_.out; o += 4 * lanes ) {
+        __m256 a0 = _mm256_loadu_ps ( d_.b + o ), a1 = _mm256_loadu_ps ( d_.b + o + lanes ),
+               a2 = _mm256_loadu_ps ( d_.b + o + 2 * lanes ), a3 = _mm256_loadu_ps ( d_.b + o + 3 * lanes );
+        for ( int i = 0; i < d_.in; ++i ) {
+            __m256 const x  = _mm256_broadcast_ss ( x_ + i );
+            float const * w = d_.w + i * d_.out + o;
+            a0              = _mm256_fmadd_ps ( x, _mm256_loadu_ps ( w ), a0 );
+            a1              = _mm256_fmadd_ps ( x, _mm256_loadu_ps ( w + lanes ), a1 );
+            a2              = _mm256_fmadd_ps ( x, _mm256_loadu_ps ( w + 2 * lanes ), a2 );
+            a3              = _mm256_fmadd_ps ( x, _mm256_loadu_ps ( w + 3 * lanes ), a3 );
+        }
+        if ( relu_ ) {
+            a0 = _mm256_max_ps ( a0, zero ), a1 = _mm256_max_ps ( a1, zero );
+            a2 = _mm256_max_ps ( a2, zero ), a3 = _mm256_max_ps ( a3, zero );
+        }
+        _mm256_storeu_ps ( y_ + o, a0 ), _mm256_storeu_ps ( y_ + o + lanes, a1 );
+        _mm256_storeu_ps ( y_ + o + 2 * lanes, a2 ), _mm256_storeu_ps ( y_ + o + 3 * lanes, a3 );
+    }
+    for ( ; o < d_.out; o += lanes ) {
+        __m256 a = _mm256_loadu_ps ( d_.b + o );
+        for ( int i = 0; i < d_.in; ++i )
+            a = _mm256_fmadd_ps ( _mm256_broadcast_ss ( x_ + i ), _mm256_loadu_ps ( d_.w + i * d_.out + o ), a );
+        _mm256_storeu_ps ( y_ + o, relu_ ? _mm256_max_ps ( a, zero ) : a );
+    }
+}
+#endif
+
+inline void dense ( [[maybe_unused]] Kernel const kernel_, Weights::Dense const & d_, float const * x_, float * y_,
+                    bool const relu_ ) noexcept {
+#if defined( __AVX2__ ) and defined( __FMA__ )
+    if ( Kernel::avx2 == kernel_ and not( d_.out % lanes ) ) {
+        dense_avx2 ( d_, x_, y_, relu_ );
+        return;
+    }
+#endif
+    dense_reference ( d_, x_, y_, relu_ );
+}
+
+// The largest difference between kernel_ and the reference kernel, over the dense layers
+// of weights_ on random inputs in [ -1, 1 ], relative to the sum of the magnitudes of the
+// terms of an output. The kernels add in a different order (and fused), so they only
+// agree up to rounding.
+[[nodiscard]] inline float kernel_error ( Kernel const kernel_, Weights const & weights_, std::uint64_t const seed_ ) {
+    std::mt19937_64 engine ( seed_ );
+    std::uniform_real_distribution<float> distribution ( -1.0f, 1.0f );
+    std::vector<float> x, expected, y;
+    float error = 0.0f;
+    auto check  = [ & ] ( Weights::Dense const & d_ ) {
+        x.resize ( d_.in );
+        expected.resize ( d_.out );
+        y.resize ( d_.out );
+        for ( float & f : x )
+            f = distribution ( engine );
+        for ( bool const relu : { false, true } ) {
+            dense_reference ( d_, x.data ( ), expected.data ( ), relu );
+            dense ( kernel_, d_, x.data ( ), y.data ( ), relu );
+            for ( int o = 0; o < d_.out; ++o ) {
+                float magnitude = std::abs ( d_.b[ o ] );
+                for ( int i = 0; i < d_.in; ++i )
+                    magnitude += std::abs ( x[ i ] * d_.w[ i * d_.out + o ] );
+                error = std::max ( error, std::abs ( y[ o ] - expected[ o ] ) / std::max ( magnitude, 1.0f ) );
+            }
+        }
+    };
+    for ( auto const & layer : weights_.layers ( ) )
+        check ( layer );
+    check ( weights_.policy ( ) );
+    check ( weights_.value_hidden ( ) );
+    check ( weights_.value ( ) );
+    return error;
+}
+
+// The neighbors of all cells, 6 per cell, -1 is off the board.
+template<typename Board>
+[[nodiscard]] std::int16_t const * stencil ( ) noexcept {
+    static std::array<std::int16_t, 6 * Board::size ( )> const s = [] ( ) {
+        std::array<std::int16_t, 6 * Board::size ( )> s;
+        s.fill ( -1 );
+        for ( int c = 0; c < Board::size ( ); ++c )
+            std::copy ( std::begin ( Board::neighbors[ c ] ), std::end ( Board::neighbors[ c ] ), std::begin ( s ) + 6 * c );
+        return s;
+    }( );
+    return s.data ( );
+}
+
+// The input features of the position, from the point of view of the player to move.
+template<typename State>
+void encode ( State const & state_, float * x_ ) noexcept {
+    using Board        = typename State::Board;
+    auto const & p     = state_.position ( );
+    float const slides = static_cast<float> ( p.m_slides ) / 6.0f;
+    for ( int c = 0; c < Board::size ( ); ++c, x_ += input_channels ) {
+        x_[ 0 ] = p.m_player_to_move == p.m_board[ c ];
+        x_[ 1 ] = p.m_board[ c ] == p.m_player_to_move.opponent ( );
+        x_[ 2 ] = p.m_board[ c ].vacant ( );
+        x_[ 3 ] = static_cast<float> ( 6 - static_cast<int> ( Board::neighbors[ c ].size ( ) ) ) / 6.0f;
+        x_[ 4 ] = slides;
+        x_[ 5 ] = 1.0f;
+        x_[ 6 ] = x_[ 7 ] = 0.0f;
+    }
+}
+
+class Evaluator {
+
+    public:
+    explicit Evaluator ( Weights const & weights_, int const batch_size_ = 1, Kernel const kernel_ = default_kernel,
+                         std::chrono::microseconds const max_wait_ = std::chrono::microseconds{ 200 } ) noexcept :
+        m_weights ( weights_ ),
+        m_batch_size ( std::max ( batch_size_, 1 ) ), m_kernel ( kernel_ ), m_max_wait ( max_wait_ ) {
+        // Debug builds check the kernel against the reference, on the weights played, and on
+        // random weights 40 channels wide, which runs both loops of dense_avx2 ( ).
+        assert ( kernel_error ( m_kernel, weights_, 1u ) < 1e-5f );
+        assert ( kernel_error ( m_kernel, Weights ( 40, 2, 24, 2u ), 3u ) < 1e-5f );
+    }
+
+    // The value of the position for the player to move, in [ -1, 1 ], and the priors of
+    // the moves_ (summing to 1).
+    template<typename State>
+    [[nodiscard]] float evaluate ( State const & state_, typename State::Moves const & moves_, float * priors_ ) {
+        using Board = typename State::Board;
+        static thread_local std::vector<float> input, logits;
+        input.resize ( input_channels * Board::size ( ) );
+        logits.resize ( policy_outputs * Board::size ( ) );
+        encode ( state_, input.data ( ) );
+        Request request{ Board::size ( ), stencil<Board> ( ), input.data ( ), logits.data ( ) };
+        submit ( request );
+        float max = std::numeric_limits<float>::lowest ( ), sum = 0.0f;
+        for ( int i = 0; i < static_cast<int> ( moves_.size ( ) ); ++i ) {
+            auto const & m = moves_[ i ];
+            priors_[ i ]   = m.is_placement ( ) ? logits[ policy_outputs * m.to ]
+                                              : logits[ policy_outputs * m.from + 1 ] + logits[ policy_outputs * m.to + 2 ];
+            max            = std::max ( max, priors_[ i ] );
+        }
+        for ( int i = 0; i < static_cast<int> ( moves_.size ( ) ); ++i )
+            sum += ( priors_[ i ] = std::exp ( priors_[ i ] - max ) );
+        for ( int i = 0; i < static_cast<int> ( moves_.size ( ) ); ++i )
+            priors_[ i ] /= sum;
+        return request.value;
+    }
+
+    private:
+    struct Request {
+        int cells;
+        std::int16_t const * neighbors;
+        float const * input;
+        float * logits;
+        float value = 0.0f;
+        bool taken = false, done = false;
+    };
+
+    // Queues the request_, the thread that fills the batch, or that waited long enough for
+    // that to happen, runs all queued requests.
+    void submit ( Request & request_ ) {
+        std::unique_lock<std::mutex> lock ( m_mutex );
+        m_pending.push_back ( &request_ );
+        bool timed_out = false;
+        while ( not request_.done ) {
+            if ( not request_.taken and ( static_cast<int> ( m_pending.size ( ) ) >= m_batch_size or timed_out ) ) {
+                std::vector<Request *> batch;
+                batch.swap ( m_pending );
+                for ( Request * r : batch )
+                    r->taken = true;
+                lock.unlock ( );
+                run ( batch );
+                lock.lock ( );
+                for ( Request * r : batch )
+                    r->done = true;
+                m_cv.notify_all ( );
+                return;
+            }
+            timed_out = std::cv_status::timeout == m_cv.wait_for ( lock, m_max_wait );
+        }
+    }
+
+    // Layer by layer, over the whole batch, so that the weights of a layer stay in the cache.
+    void run ( std::vector<Request *> const & batch_ ) const {
+        int const channels = m_weights.channels ( );
+        static thread_local std::vector<float> a, b, sum;
+        std::size_t cells = 0u;
+        for ( Request const * r : batch_ )
+            cells += static_cast<std::size_t> ( r->cells );
+        a.resize ( cells * channels );
+        b.resize ( cells * channels );
+        sum.resize ( 2 * channels );
+        // The trunk, from the input, through a and b.
+        for ( std::size_t l = 0; l < m_weights.layers ( ).size ( ); ++l ) {
+            auto const & layer = m_weights.layers ( )[ l ];
+            int const in       = layer.in / 2;
+            float * y          = b.data ( );
+            float const * x    = a.data ( );
+            for ( Request const * r : batch_ ) {
+                if ( 0 == l )
+                    x = r->input;
+                for ( int c = 0; c < r->cells; ++c, y += channels ) {
+                    // The cell itself, and the sum of its neighbors.
+                    std::copy ( x + c * in, x + ( c + 1 ) * in, sum.data ( ) );
+                    std::fill ( sum.data ( ) + in, sum.data ( ) + 2 * in, 0.0f );
+                    for ( int n = 0; n < 6; ++n )
+                        if ( int const neighbor = r->neighbors[ 6 * c + n ]; neighbor >= 0 )
+                            for ( int i = 0; i < in; ++i )
+                                sum[ in + i ] += x[ neighbor * in + i ];
+                    dense ( m_kernel, layer, sum.data ( ), y, true );
+                }
+                x += r->cells * in;
+            }
+            a.swap ( b );
+        }
+        // The heads.
+        float const * x = a.data ( );
+        std::vector<float> mean ( channels ), hidden ( m_weights.value_hidden ( ).out ), policy ( lanes );
+        for ( Request * r : batch_ ) {
+            std::fill ( std::begin ( mean ), std::end ( mean ), 0.0f );
+            for ( int c = 0; c < r->cells; ++c, x += channels ) {
+                dense ( m_kernel, m_weights.policy ( ), x, policy.data ( ), false );
+                std::copy ( policy.data ( ), policy.data ( ) + policy_outputs, r->logits + policy_outputs * c );
+                for ( int i = 0; i < channels; ++i )
+                    mean[ i ] += x[ i ];
+            }
+            for ( int i = 0; i < channels; ++i )
+                mean[ i ] /= static_cast<float> ( r->cells );
+            dense ( m_kernel, m_weights.value_hidden ( ), mean.data ( ), hidden.data ( ), true );
+            dense_reference ( m_weights.value ( ), hidden.data ( ), &r->value, false );
+            r->value = std::tanh ( r->value );
+        }
+    }
+
+    Weights const & m_weights;
+    int const m_batch_size;
+    Kernel const m_kernel;
+    std::chrono::microseconds const m_max_wait;
+    std::mutex m_mutex;
+    std::condition_variable m_cv;
+    std::vector<Request *> m_pending;
+};
+
+} // namespace NeuralNet
@@ -0,0 +1,198 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Perft, counts the move sequences of a given length (the leaves of the game tree at
+// that depth, a finished game has no moves), to validate and benchmark the move
+// generation (availableMoves ( ) and moveHashWinner ( )). The moves of the last ply are
+// only counted (bulk counting), not made, and the counts of sub-trees are cached by
+// zobrist ( ) (and depth), transpositions are common in Mado. The root moves are
+// divided over the threads.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <iostream>
+#include <memory>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include <experimental/fixed_capacity_vector>
+
+namespace Perft {
+
+template<typename Move>
+struct Result {
+    std::uint64_t nodes = 0u;
+    double seconds      = 0.0;
+    std::vector<std::pair<Move, std::uint64_t>> divide; // The count of every root move.
+
+    [[nodiscard]] double nps ( ) const noexcept { return seconds > 0.0 ? static_cast<double> ( nodes ) / seconds : 0.0; }
+};
+
+// Lock-free, the key of an entry is stored xor-ed with its count, a torn entry does not
+// match.
+class Cache {
+
+    public:
+    explicit Cache ( std::size_t const size_ ) : m_mask ( capacity ( size_ / sizeof ( Entry ) ) - 1u ) {
+        m_entries = std::make_unique<Entry[]> ( m_mask + 1u );
+    }
+
+    [[nodiscard]] bool probe ( std::uint64_t const key_, std::uint64_t & count_ ) const noexcept {
+        Entry const & e        = m_entries[ key_ & m_mask ];
+        std::uint64_t const c  = e.count.load ( std::memory_order_relaxed );
+        if ( ( e.check.load ( std::memory_order_relaxed ) ^ c ) != key_ )
+            return false;
+        count_ = c;
+        return true;
+    }
+
+    void store ( std::uint64_t const key_, std::uint64_t const count_ ) noexcept {
+        Entry & e = m_entries[ key_ & m_mask ];
+        e.count.store ( count_, std::memory_order_relaxed );
+        e.check.store ( key_ ^ count_, std::memory_order_relaxed );
+    }
+
+    // The key of a position at a depth.
+    [[nodiscard]] static std::uint64_t key ( std::uint64_t const zobrist_, int const depth_ ) noexcept {
+        std::uint64_t k = static_cast<std::uint64_t> ( depth_ ) + std::uint64_t{ 0x9e3779b97f4a7c15 };
+        k               = ( k ^ ( k >> 30 ) ) * std::uint64_t{ 0xbf58476d1ce4e5b9 };
+        k               = ( k ^ ( k >> 27 ) ) * std::uint64_t{ 0x94d049bb133111eb };
+        return zobrist_ ^ k ^ ( k >> 31 );
+    }
+
+    private:
+    struct Entry {
+        std::atomic<std::uint64_t> check{ 0u }, count{ 0u };
+    };
+
+    [[nodiscard]] static std::size_t capacity ( std::size_t const n_ ) noexcept {
+        std::size_t c = 1u;
+        while ( c < n_ )
+            c <<= 1;
+        return c;
+    }
+
+    std::size_t const m_mask;
+    std::unique_ptr<Entry[]> m_entries;
+};
+
+template<typename State>
+[[nodiscard]] std::uint64_t count ( State const & state_, int const depth_, Cache * const cache_ ) noexcept {
+    if ( 0 == depth_ )
+        return 1u;
+    if ( state_.terminal ( ) )
+        return 0u;
+    std::experimental::fixed_capacity_vector<typename State::Move, std::size_t{ State::Board::size ( ) } * std::size_t{ 2 }> moves;
+    int const size = state_.availableMoves ( moves );
+    if ( 1 == depth_ )
+        return static_cast<std::uint64_t> ( size );
+    std::uint64_t const key = Cache::key ( state_.zobrist ( ), depth_ );
+    std::uint64_t n         = 0u;
+    if ( cache_ and cache_->probe ( key, n ) )
+        return n;
+    for ( auto const move : moves ) {
+        State child = state_;
+        child.moveHashWinner ( move );
+        n += count ( child, depth_ - 1, cache_ );
+    }
+    if ( cache_ )
+        cache_->store ( key, n );
+    return n;
+}
+
+// The zobrist hash of state_ has to be up to date (all moves made with moveHash... ( )),
+// a cache_size_ of 0 is no cache.
+template<typename State>
+[[nodiscard]] Result<typename State::Move> perft ( State const & state_, int const depth_, int const number_of_threads_ = 1,
+                                                   std::size_t const cache_size_ = std::size_t{ 1 } << 26 ) {
+    Result<typename State::Move> result;
+    auto const start = std::chrono::steady_clock::now ( );
+    std::unique_ptr<Cache> cache;
+    if ( cache_size_ )
+        cache = std::make_unique<Cache> ( cache_size_ );
+    if ( depth_ < 2 or state_.terminal ( ) ) {
+        result.nodes = count ( state_, depth_, cache.get ( ) );
+    }
+    else {
+        for ( auto const move : state_.availableMoves ( ) )
+            result.divide.emplace_back ( move, 0u );
+        std::atomic<std::size_t> next{ 0u };
+        auto work = [ & ] ( ) {
+            for ( std::size_t i; ( i = next.fetch_add ( 1u, std::memory_order_relaxed ) ) < result.divide.size ( ); ) {
+                State child = state_;
+                child.moveHashWinner ( result.divide[ i ].first );
+                result.divide[ i ].second = count ( child, depth_ - 1, cache.get ( ) );
+            }
+        };
+        std::vector<std::thread> threads;
+        for ( int t = 1; t < number_of_threads_; ++t )
+            threads.emplace_back ( work );
+        work ( );
+        for ( auto & thread : threads )
+            thread.join ( );
+        for ( auto const & d : result.divide )
+            result.nodes += d.second;
+    }
+    result.seconds = std::chrono::duration<double> ( std::chrono::steady_clock::now ( ) - start ).count ( );
+    return result;
+}
+
+// perft ( Mado<R> ( ), depth ), for depth 1, 2, ... (i.e. the first element is depth 1).
+template<int R>
+[[nodiscard]] constexpr auto reference ( ) noexcept {
+    if constexpr ( 2 == R )
+        return std::array<std::uint64_t, 7>{ 19u, 342u, 7'242u, 146'082u, 3'242'622u, 68'546'412u, 1'540'915'062u };
+    else if constexpr ( 3 == R )
+        return std::array<std::uint64_t, 6>{ 37u, 1'332u, 52'920u, 2'049'570u, 85'460'646u, 3'476'871'456u };
+    else if constexpr ( 4 == R )
+        return std::array<std::uint64_t, 6>{ 61u, 3'660u, 234'348u, 14'770'890u, 982'686'558u, 64'390'134'840u };
+    else
+        return std::array<std::uint64_t, 5>{ 91u, 8'190u, 771'630u, 71'928'498u, 6'980'356'254u };
+}
+
+// Compares perft from the start position with the reference counts, prints the counts
+// and the nodes per second.
+template<typename State>
+[[nodiscard]] bool check ( int const number_of_threads_ = static_cast<int> ( std::thread::hardware_concurrency ( ) ) ) {
+    static_assert ( State::Board::radius ( ) >= 2 and State::Board::radius ( ) <= 5, "no reference counts" );
+    bool passed = true;
+    int depth   = 1;
+    for ( std::uint64_t const expected : reference<State::Board::radius ( )> ( ) ) {
+        auto const r = perft ( State ( ), depth, number_of_threads_ );
+        std::cout << "R " << State::Board::radius ( ) << " depth " << depth++ << ": " << r.nodes
+                  << ( r.nodes == expected ? " ok " : " FAILED " ) << static_cast<std::uint64_t> ( r.nps ( ) ) << " nps"
+                  << std::endl;
+        passed = passed and r.nodes == expected;
+    }
+    return passed;
+}
+
+} // namespace Perft
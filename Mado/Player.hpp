@@ -38,6 +38,7 @@
 
 #include "Globals.hpp"
 #include "Hexcontainer.hpp"
+#include "Wire.hpp"
 
 template<int R>
 struct Player {
@@ -113,3 +114,23 @@ struct Player {
         ar_ ( value );
     }
 };
+
+template<int R>
+struct Wire::Layout<Player<R>> {
+
+    using value_type = std::underlying_type_t<typename Player<R>::Type>;
+
+    struct type {
+        Little<value_type> value;
+    };
+
+    static_assert ( sizeof ( type ) == sizeof ( value_type ) and alignof ( type ) == 1, "a player is its value" );
+
+    static constexpr std::uint32_t version = 1u;
+    static constexpr bool identity         = little_endian or 1 == sizeof ( value_type );
+
+    [[nodiscard]] static type pack ( Player<R> const & p_ ) noexcept { return { static_cast<value_type> ( p_.value ) }; }
+    static void unpack ( type const & t_, Player<R> & p_ ) noexcept {
+        p_.value = static_cast<typename Player<R>::Type> ( static_cast<value_type> ( t_.value ) );
+    }
+};
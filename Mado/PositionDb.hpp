@@ -0,0 +1,382 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A database of the positions of recorded games (Game::Writer), the (aggregate) results
+// of the games in which every position occurred, and references to (some of) those games.
+// Equivalent (symmetric) positions share an entry, keyed by canonicalZobrist ( ). The
+// results are from the point of view of the player to move.
+//
+// | header 64 | entries | references | sparse index |, the entries sorted by key, the
+// references (the numbers of the games in the game file) of an entry are contiguous, the
+// sparse index holds the key of every sparse_stride-th entry. A lookup bisects the sparse
+// index, and then a stride of entries, in place, memory mapped.
+//
+// It is built by an external sort, the threads replay the games, and write sorted runs
+// of occurrences, the runs are then memory mapped and merged, every thread merging the
+// occurrences in its own range of keys.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <atomic>
+#include <exception>
+#include <filesystem>
+#include <fstream>
+#include <limits>
+#include <mutex>
+#include <queue>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <system_error>
+#include <thread>
+#include <vector>
+
+#include "GameRecord.hpp"
+#include "MappedFile.hpp"
+
+namespace PositionDb {
+
+// | magic 8 | version 4 | radius 4 | entries 8 | references 8 | games 8 | sparse stride 8 |
+// reserved 16 |.
+struct Header {
+    char magic[ 8 ]             = { 'M', 'A', 'D', 'O', 'P', 'D', 'B', '\0' };
+    std::uint32_t version       = 1u;
+    std::uint32_t radius        = 0u;
+    std::uint64_t entries       = 0u;
+    std::uint64_t references    = 0u;
+    std::uint64_t games         = 0u; // in the game file.
+    std::uint64_t sparse_stride = 0u;
+    std::uint8_t reserved[ 16 ] = { };
+};
+
+static_assert ( sizeof ( Header ) == 64, "the entries have to start at a 64 byte boundary" );
+
+struct Entry {
+    std::uint64_t key       = 0u; // canonicalZobrist ( ).
+    std::uint32_t wins      = 0u;
+    std::uint32_t draws     = 0u;
+    std::uint32_t losses    = 0u;
+    std::uint32_t games     = 0u; // the number of references.
+    std::uint64_t reference = 0u; // the first reference.
+
+    [[nodiscard]] std::uint32_t occurrences ( ) const noexcept { return wins + draws + losses; }
+};
+
+static_assert ( sizeof ( Entry ) == 32, "entries are stored as they are in memory" );
+
+inline constexpr std::uint64_t sparse_stride = 256u;
+
+struct Options {
+    int number_of_threads;      // replaying and merging.
+    std::size_t run_size;       // the number of occurrences of a run (per thread, 16 bytes each).
+    std::uint32_t max_games;    // the maximum number of references of an entry, the first games.
+    std::filesystem::path temp; // the runs go in a directory of their own in temp (removed after the build).
+
+    Options ( ) :
+        number_of_threads ( std::max ( 1, static_cast<int> ( std::thread::hardware_concurrency ( ) ) ) ),
+        run_size ( 1u << 22 ), max_games ( 16u ), temp ( std::filesystem::temp_directory_path ( ) / "mado_positions" ) {}
+};
+
+namespace detail {
+
+// A position in a game, the game and the result in one word, game << 2 | outcome.
+struct Occurrence {
+    std::uint64_t key = 0u, game = 0u;
+
+    [[nodiscard]] bool operator< ( Occurrence const & rhs_ ) const noexcept {
+        return key < rhs_.key or ( key == rhs_.key and game < rhs_.game );
+    }
+};
+
+enum Outcome : std::uint64_t { win = 0u, draw = 1u, loss = 2u };
+
+inline void write ( std::filesystem::path const & path_, void const * data_, std::size_t const size_ ) {
+    std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+    ostream.write ( reinterpret_cast<char const *> ( data_ ), static_cast<std::streamsize> ( size_ ) );
+    if ( not ostream )
+        throw std::runtime_error ( "PositionDb: cannot write " + path_.string ( ) );
+}
+
+// Merges the occurrences in [ lo_, hi_ ) of the runs, writes the entries and their
+// references (the references of the entries relative to the part).
+inline void merge ( std::vector<MappedFile> const & runs_, std::uint64_t const lo_, std::uint64_t const hi_, bool const last_,
+                    std::uint32_t const max_games_, std::filesystem::path const & entries_path_,
+                    std::filesystem::path const & references_path_ ) {
+    struct Cursor {
+        Occurrence const * it;
+        Occurrence const * end;
+    };
+    auto greater = [] ( Cursor const & a_, Cursor const & b_ ) noexcept { return *b_.it < *a_.it; };
+    std::priority_queue<Cursor, std::vector<Cursor>, decltype ( greater )> queue ( greater );
+    for ( auto const & run : runs_ ) {
+        Occurrence const * const begin = reinterpret_cast<Occurrence const *> ( run.data ( ) );
+        Occurrence const * const end   = begin + run.size ( ) / sizeof ( Occurrence );
+        auto key_less = [] ( Occurrence const & o_, std::uint64_t const k_ ) noexcept { return o_.key < k_; };
+        Cursor c{ std::lower_bound ( begin, end, lo_, key_less ), last_ ? end : std::lower_bound ( begin, end, hi_, key_less ) };
+        if ( c.it != c.end )
+            queue.push ( c );
+    }
+    std::ofstream entries ( entries_path_, std::ios::binary | std::ios::trunc ),
+        references ( references_path_, std::ios::binary | std::ios::trunc );
+    std::vector<Entry> entry_buffer;
+    std::vector<std::uint64_t> reference_buffer;
+    std::uint64_t reference = 0u;
+    auto flush              = [ & ] ( ) {
+        entries.write ( reinterpret_cast<char const *> ( entry_buffer.data ( ) ),
+                        static_cast<std::streamsize> ( entry_buffer.size ( ) * sizeof ( Entry ) ) );
+        references.write ( reinterpret_cast<char const *> ( reference_buffer.data ( ) ),
+                           static_cast<std::streamsize> ( reference_buffer.size ( ) * sizeof ( std::uint64_t ) ) );
+        entry_buffer.clear ( );
+        reference_buffer.clear ( );
+    };
+    while ( not queue.empty ( ) ) {
+        Cursor c = queue.top ( );
+        queue.pop ( );
+        Occurrence const o = *c.it++;
+        if ( c.it != c.end )
+            queue.push ( c );
+        if ( entry_buffer.empty ( ) or entry_buffer.back ( ).key != o.key ) {
+            if ( entry_buffer.size ( ) == 4'096u )
+                flush ( );
+            entry_buffer.push_back ( Entry{ o.key, 0u, 0u, 0u, 0u, reference } );
+        }
+        Entry & e = entry_buffer.back ( );
+        ( win == ( o.game & 3u ) ? e.wins : draw == ( o.game & 3u ) ? e.draws : e.losses ) += 1u;
+        if ( e.games < max_games_ ) { // The games are merged in order, these are the first.
+            reference_buffer.push_back ( o.game >> 2 );
+            ++e.games;
+            ++reference;
+        }
+    }
+    flush ( );
+    if ( not entries or not references )
+        throw std::runtime_error ( "PositionDb: cannot write " + entries_path_.string ( ) );
+}
+
+// A new directory in parent_, removed (with the runs in it) when the build ends, or fails,
+// concurrent builds do not share it, and parent_ (and what else is in it) is left alone.
+struct Scratch {
+    std::filesystem::path path;
+
+    explicit Scratch ( std::filesystem::path const & parent_ ) {
+        std::filesystem::create_directories ( parent_ );
+        std::random_device rd;
+        do {
+            std::ostringstream name;
+            name << "build-" << std::hex << ( std::uint64_t{ rd ( ) } << 32 | rd ( ) );
+            path = parent_ / name.str ( );
+        } while ( not std::filesystem::create_directory ( path ) );
+    }
+    Scratch ( Scratch const & ) = delete;
+    Scratch & operator= ( Scratch const & ) = delete;
+
+    ~Scratch ( ) noexcept {
+        std::error_code error;
+        std::filesystem::remove_all ( path, error );
+    }
+};
+
+} // namespace detail
+
+// Builds the database of the games in games_path_.
+template<typename State>
+void build ( std::filesystem::path const & games_path_, std::filesystem::path const & path_,
+             Options const & options_ = Options{ } ) {
+    using namespace detail;
+    using Record = typename Game::Reader<State>::Record;
+    Game::Reader<State> const games ( games_path_ );
+    Scratch const scratch ( options_.temp );
+    int const number_of_threads = std::max ( options_.number_of_threads, 1 );
+    // The first exception (e.g. of a corrupt game) is rethrown, after all threads are done.
+    auto parallel = [ & ] ( auto && f_ ) {
+        std::mutex mutex;
+        std::exception_ptr error;
+        auto work = [ & ] ( int const t_ ) {
+            try {
+                f_ ( t_ );
+            }
+            catch ( ... ) {
+                std::lock_guard<std::mutex> lock ( mutex );
+                if ( not error )
+                    error = std::current_exception ( );
+            }
+        };
+        std::vector<std::thread> threads;
+        for ( int t = 1; t < number_of_threads; ++t )
+            threads.emplace_back ( work, t );
+        work ( 0 );
+        for ( auto & thread : threads )
+            thread.join ( );
+        if ( error )
+            std::rethrow_exception ( error );
+    };
+    auto temp_path = [ & ] ( char const * const name_, int const i_ ) { return scratch.path / ( name_ + std::to_string ( i_ ) ); };
+    // The runs, the threads replay an index stride of games at a time.
+    std::atomic<std::uint64_t> next{ 0u };
+    std::atomic<int> number_of_runs{ 0 };
+    parallel ( [ & ] ( int ) {
+        std::vector<Occurrence> run;
+        run.reserve ( options_.run_size + 2u * Game::index_stride * State::Board::size ( ) );
+        auto write_run = [ & ] ( ) {
+            std::sort ( std::begin ( run ), std::end ( run ) );
+            write ( temp_path ( "run", number_of_runs++ ), run.data ( ), run.size ( ) * sizeof ( Occurrence ) );
+            run.clear ( );
+        };
+        State state;
+        for ( std::uint64_t g; ( g = next.fetch_add ( Game::index_stride, std::memory_order_relaxed ) ) < games.size ( ); ) {
+            games.for_each (
+                [ & ] ( std::uint64_t const game_, Record const & record_ ) {
+                    if ( record_.winner.invalid ( ) ) // Not played out.
+                        return;
+                    state.reset ( );
+                    for ( std::uint8_t const * p = record_.begin; p < record_.end; ) {
+                        state.moveWinner ( Game::decode<State> ( p, record_.end ) );
+                        int symmetry                = 0;
+                        std::uint64_t const outcome = record_.winner.vacant ( )                        ? draw
+                                                      : record_.winner == state.playerToMove ( ) ? win
+                                                                                                     : loss;
+                        run.push_back ( Occurrence{ state.canonicalZobrist ( symmetry ), game_ << 2 | outcome } );
+                    }
+                },
+                g, std::min ( g + Game::index_stride, games.size ( ) ) );
+            if ( run.size ( ) >= options_.run_size )
+                write_run ( );
+        }
+        if ( not run.empty ( ) )
+            write_run ( );
+    } );
+    // The merge, every thread a range of keys (the keys are uniformly distributed).
+    std::vector<MappedFile> runs;
+    for ( int r = 0; r < number_of_runs; ++r )
+        runs.emplace_back ( temp_path ( "run", r ) );
+    std::uint64_t const range = std::numeric_limits<std::uint64_t>::max ( ) / static_cast<std::uint64_t> ( number_of_threads );
+    parallel ( [ & ] ( int const t_ ) {
+        std::uint64_t const t = static_cast<std::uint64_t> ( t_ );
+        merge ( runs, t * range, ( t + 1u ) * range, number_of_threads - 1 == t_, options_.max_games, temp_path ( "entries", t_ ),
+                temp_path ( "references", t_ ) );
+    } );
+    runs.clear ( );
+    // The parts are concatenated, the references rebased, and the sparse index collected.
+    std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+    if ( not ostream )
+        throw std::runtime_error ( "PositionDb: cannot write " + path_.string ( ) );
+    Header header;
+    header.radius        = static_cast<std::uint32_t> ( State::Hex::radius ( ) );
+    header.games         = games.size ( );
+    header.sparse_stride = sparse_stride;
+    ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+    std::vector<std::uint64_t> sparse;
+    std::vector<Entry> entries ( 4'096u );
+    for ( int t = 0; t < number_of_threads; ++t ) {
+        std::ifstream istream ( temp_path ( "entries", t ), std::ios::binary );
+        while ( istream.read ( reinterpret_cast<char *> ( entries.data ( ) ),
+                               static_cast<std::streamsize> ( entries.size ( ) * sizeof ( Entry ) ) ) or
+                istream.gcount ( ) ) {
+            std::size_t const n = static_cast<std::size_t> ( istream.gcount ( ) ) / sizeof ( Entry );
+            for ( std::size_t i = 0u; i < n; ++i ) {
+                if ( 0u == header.entries++ % sparse_stride )
+                    sparse.push_back ( entries[ i ].key );
+                entries[ i ].reference += header.references;
+            }
+            ostream.write ( reinterpret_cast<char const *> ( entries.data ( ) ),
+                            static_cast<std::streamsize> ( n * sizeof ( Entry ) ) );
+        }
+        header.references += std::filesystem::file_size ( temp_path ( "references", t ) ) / sizeof ( std::uint64_t );
+    }
+    for ( int t = 0; t < number_of_threads; ++t )
+        if ( std::filesystem::file_size ( temp_path ( "references", t ) ) )
+            ostream << std::ifstream ( temp_path ( "references", t ), std::ios::binary ).rdbuf ( );
+    ostream.write ( reinterpret_cast<char const *> ( sparse.data ( ) ),
+                    static_cast<std::streamsize> ( sparse.size ( ) * sizeof ( std::uint64_t ) ) );
+    ostream.seekp ( 0 );
+    ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+    ostream.close ( );
+    if ( not ostream )
+        throw std::runtime_error ( "PositionDb: cannot write " + path_.string ( ) );
+}
+
+class Database {
+
+    public:
+    explicit Database ( std::filesystem::path const & path_ ) : m_file ( path_ ) {
+        Header expected;
+        if ( m_file.size ( ) < sizeof ( Header ) )
+            throw std::runtime_error ( "PositionDb: not a database " + path_.string ( ) );
+        std::memcpy ( &m_header, m_file.data ( ), sizeof ( Header ) );
+        if ( std::memcmp ( m_header.magic, expected.magic, sizeof ( m_header.magic ) ) or expected.version != m_header.version or
+             0u == m_header.sparse_stride )
+            throw std::runtime_error ( "PositionDb: wrong database " + path_.string ( ) );
+        std::uint64_t const sparse_size = ( m_header.entries + m_header.sparse_stride - 1u ) / m_header.sparse_stride;
+        if ( m_file.size ( ) < sizeof ( Header ) + m_header.entries * sizeof ( Entry ) +
+                                   ( m_header.references + sparse_size ) * sizeof ( std::uint64_t ) )
+            throw std::runtime_error ( "PositionDb: truncated database " + path_.string ( ) );
+        m_entries    = reinterpret_cast<Entry const *> ( m_file.data ( ) + sizeof ( Header ) );
+        m_references = reinterpret_cast<std::uint64_t const *> ( m_entries + m_header.entries );
+        m_sparse     = m_references + m_header.references;
+        m_sparse_end = m_sparse + sparse_size;
+    }
+
+    [[nodiscard]] Entry const * find ( std::uint64_t const key_ ) const noexcept {
+        std::uint64_t const * const s = std::upper_bound ( m_sparse, m_sparse_end, key_ );
+        if ( s == m_sparse )
+            return nullptr;
+        Entry const * const first = m_entries + ( s - m_sparse - 1 ) * m_header.sparse_stride;
+        Entry const * const last  = std::min ( first + m_header.sparse_stride, m_entries + m_header.entries );
+        Entry const * const e     = std::lower_bound (
+            first, last, key_, [] ( Entry const & e_, std::uint64_t const k_ ) noexcept { return e_.key < k_; } );
+        return e != last and e->key == key_ ? e : nullptr;
+    }
+
+    // The entry of the position of state_ (or of an equivalent one), or nullptr, iff it did
+    // not occur (or the database is of another board).
+    template<typename State>
+    [[nodiscard]] Entry const * probe ( State const & state_ ) const noexcept {
+        if ( State::Board::radius ( ) != static_cast<int> ( m_header.radius ) )
+            return nullptr;
+        int symmetry = 0;
+        return find ( state_.canonicalZobrist ( symmetry ) );
+    }
+
+    // The (numbers of the) first games in which the position of the entry occurred.
+    [[nodiscard]] std::uint64_t const * begin ( Entry const & e_ ) const noexcept { return m_references + e_.reference; }
+    [[nodiscard]] std::uint64_t const * end ( Entry const & e_ ) const noexcept { return m_references + e_.reference + e_.games; }
+
+    [[nodiscard]] std::uint64_t size ( ) const noexcept { return m_header.entries; }
+    [[nodiscard]] std::uint64_t games ( ) const noexcept { return m_header.games; }
+
+    private:
+    MappedFile m_file;
+    Header m_header;
+    Entry const * m_entries            = nullptr;
+    std::uint64_t const * m_references = nullptr;
+    std::uint64_t const * m_sparse     = nullptr;
+    std::uint64_t const * m_sparse_end = nullptr;
+};
+
+} // namespace PositionDb
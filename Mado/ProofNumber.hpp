@@ -0,0 +1,302 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Depth-first proof-number search (df-pn), proves or disproves "the player to move
+// (at the root) wins", within a budget of nodes. Mado ends in a sudden surround, wins
+// are often forced many moves before the end, which is what this is good at.
+//
+// The search is in the AND/OR form, from the point of view of the player to move at the
+// root, as a draw (six slides in a row) is not a win for either player. The nodes are
+// only kept in the transposition table (16 bytes per position). The multi-threaded
+// variant runs df-pn from the root on all threads, sharing the table, every thread
+// breaks ties between children in a different order, so that they diverge.
+//
+// [1] Nagai, A. (2002). Df-pn algorithm for searching AND/OR trees and its applications.
+//     PhD thesis, University of Tokyo.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <future>
+#include <iostream>
+#include <limits>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+#include <experimental/fixed_capacity_vector>
+
+namespace ProofNumber {
+
+struct ComputeOptions {
+
+    int number_of_threads;
+    std::int64_t max_nodes; // of all threads together.
+    std::size_t table_size; // in bytes, of the transposition table.
+    bool verbose;
+
+    ComputeOptions ( ) :
+        number_of_threads ( 1 ), max_nodes ( 1'000'000 ), table_size ( std::size_t{ 1 } << 24 ), verbose ( false ) {}
+};
+
+enum class Value : int { unknown = 0, proven, disproven };
+
+template<typename Move>
+struct Result {
+    Value value = Value::unknown;
+    Move move; // A winning move, iff proven.
+    std::int64_t nodes = 0;
+};
+
+using Number = std::uint32_t;
+
+inline constexpr Number const infinity = std::numeric_limits<Number>::max ( ) / 2;
+
+[[nodiscard]] constexpr Number add ( Number const a_, Number const b_ ) noexcept { return std::min ( a_ + b_, infinity ); }
+
+// A hash of the full position (board, slides and player to move). A false hit in the
+// table leads to a false proof, so the key does not depend on the state having been
+// moved with moveHash ( ) (zobrist ( ) is only maintained by those).
+template<typename State>
+[[nodiscard]] std::uint64_t key ( State const & state_ ) noexcept {
+    auto const & position = state_.position ( );
+    // FNV-1a, ...
+    std::uint64_t h = 0xcbf2'9ce4'8422'2325ull;
+    auto fnv        = [ &h ] ( int const v_ ) noexcept {
+        h = ( h ^ static_cast<std::uint64_t> ( v_ & 0xff ) ) * 0x0000'0100'0000'01b3ull;
+    };
+    for ( auto const field : position.m_board )
+        fnv ( field.as_index ( ) );
+    fnv ( position.m_slides );
+    fnv ( position.m_player_to_move.as_index ( ) );
+    // ... finalized with the SplitMix64 mixer.
+    h = ( h ^ ( h >> 30 ) ) * 0xbf58'476d'1ce4'e5b9ull;
+    h = ( h ^ ( h >> 27 ) ) * 0x94d0'49bb'1331'11ebull;
+    h = h ^ ( h >> 31 );
+    return h ? h : 1u; // 0 is an empty entry.
+}
+
+// Open addressing in buckets of 4 entries, a bucket is guarded by one of a fixed number
+// of (striped) locks, as the threads read and update the proof and disproof numbers.
+class TranspositionTable {
+
+    public:
+    struct Entry {
+        std::uint64_t key = 0u;
+        Number pn = 1, dn = 1;
+        Number work = 0; // the nodes expanded below the position, so far.
+    };
+
+    explicit TranspositionTable ( std::size_t const bytes_ ) {
+        std::size_t n = 1;
+        while ( ( n << 1 ) * sizeof ( Bucket ) <= bytes_ )
+            n <<= 1;
+        m_mask    = n - 1;
+        m_buckets = std::make_unique<Bucket[]> ( n );
+    }
+
+    // The proof and disproof numbers of the position, ( 1, 1 ) if not in the table.
+    [[nodiscard]] Entry get ( std::uint64_t const key_ ) const noexcept {
+        std::lock_guard<std::mutex> lock ( m_locks[ key_ & ( locks - 1 ) ] );
+        for ( Entry const & e : m_buckets[ key_ & m_mask ] )
+            if ( e.key == key_ )
+                return e;
+        return Entry{ key_ };
+    }
+
+    // Replaces the same position, an empty entry, or else the entry with the least work, an
+    // unsolved one on a tie. A full bucket of solved entries still takes the store, the search
+    // would otherwise keep re-expanding a position it cannot record.
+    void put ( Entry const & entry_ ) noexcept {
+        std::lock_guard<std::mutex> lock ( m_locks[ entry_.key & ( locks - 1 ) ] );
+        Bucket & bucket = m_buckets[ entry_.key & m_mask ];
+        Entry * victim  = bucket.data ( );
+        for ( Entry & e : bucket ) {
+            if ( e.key == entry_.key or not e.key ) {
+                victim = &e;
+                break;
+            }
+            if ( e.work < victim->work or ( e.work == victim->work and e.pn and e.dn ) )
+                victim = &e;
+        }
+        *victim = entry_;
+    }
+
+    private:
+    static constexpr std::size_t locks = 1'024;
+
+    using Bucket = std::array<Entry, 4>;
+
+    std::unique_ptr<Bucket[]> m_buckets;
+    std::size_t m_mask;
+    mutable std::array<std::mutex, locks> m_locks;
+};
+
+template<typename State>
+class Solver {
+
+    public:
+    using Move  = typename State::Move;
+    using Moves = std::experimental::fixed_capacity_vector<Move, std::size_t{ State::Board::size ( ) } * std::size_t{ 2 }>;
+    using Keys  = std::array<std::uint64_t, std::size_t{ State::Board::size ( ) } * std::size_t{ 2 }>;
+
+    Solver ( TranspositionTable & table_, std::atomic<std::int64_t> & nodes_, std::int64_t const max_nodes_,
+             typename State::value_type const attacker_, int const tie_break_ ) noexcept :
+        m_table ( table_ ),
+        m_nodes ( nodes_ ), m_max_nodes ( max_nodes_ ), m_attacker ( attacker_ ), m_tie_break ( tie_break_ ) {}
+
+    // Runs df-pn on root_state_, until it is solved, or the node budget is spent.
+    void solve ( State const & root_state_ ) {
+        TranspositionTable::Entry root = m_table.get ( key ( root_state_ ) );
+        while ( root.pn and root.dn and not out_of_nodes ( ) ) {
+            mid ( root_state_, infinity, infinity );
+            root = m_table.get ( key ( root_state_ ) );
+        }
+    }
+
+    private:
+    [[nodiscard]] bool out_of_nodes ( ) const noexcept { return m_nodes.load ( std::memory_order_relaxed ) >= m_max_nodes; }
+
+    // The proof and disproof numbers of a terminal position.
+    [[nodiscard]] TranspositionTable::Entry terminal ( State const & state_ ) const noexcept {
+        return state_.winner ( ) == m_attacker ? TranspositionTable::Entry{ key ( state_ ), 0, infinity, 1 }
+                                               : TranspositionTable::Entry{ key ( state_ ), infinity, 0, 1 };
+    }
+
+    // Multiple iterative deepening, expands state_ until its proof number reaches th_pn_,
+    // or its disproof number reaches th_dn_.
+    void mid ( State const & state_, Number const th_pn_, Number const th_dn_ ) {
+        m_nodes.fetch_add ( 1, std::memory_order_relaxed );
+        std::int64_t const expanded = m_expanded++;
+        if ( state_.terminal ( ) ) { // Only if it was dropped from the table.
+            m_table.put ( terminal ( state_ ) );
+            return;
+        }
+        bool const is_or = state_.playerToMove ( ) == m_attacker;
+        Moves moves;
+        int const n = state_.availableMoves ( moves );
+        Keys keys;
+        for ( int i = 0; i < n; ++i ) {
+            State child = state_;
+            child.moveWinner ( moves[ i ] );
+            keys[ i ] = key ( child );
+            if ( child.terminal ( ) )
+                m_table.put ( terminal ( child ) );
+        }
+        TranspositionTable::Entry node = m_table.get ( key ( state_ ) );
+        for ( ;; ) {
+            // Combine the children, the best child is the one with the smallest pn (or-node),
+            // or dn (and-node), the tie-break rotates the order the children are looked at.
+            Number min = infinity, second = infinity, sum = 0;
+            int best       = -1;
+            Number best_pn = infinity, best_dn = infinity;
+            for ( int j = 0; j < n; ++j ) {
+                int const i                       = ( j + m_tie_break ) % n;
+                TranspositionTable::Entry const c = m_table.get ( keys[ i ] );
+                Number const minimized = is_or ? c.pn : c.dn, summed = is_or ? c.dn : c.pn;
+                sum = add ( sum, summed );
+                if ( minimized < min ) {
+                    second  = min;
+                    min     = minimized;
+                    best    = i;
+                    best_pn = c.pn;
+                    best_dn = c.dn;
+                }
+                else if ( minimized < second )
+                    second = minimized;
+            }
+            if ( not n ) // No moves, not a win.
+                min = is_or ? infinity : 0, sum = is_or ? 0 : infinity;
+            node.pn = is_or ? min : sum;
+            node.dn = is_or ? sum : min;
+            if ( node.pn >= th_pn_ or node.dn >= th_dn_ or out_of_nodes ( ) )
+                break;
+            State child = state_;
+            child.moveWinner ( moves[ best ] );
+            if ( is_or )
+                mid ( child, std::min ( th_pn_, add ( second, 1 ) ), add ( th_dn_ - node.dn, best_dn ) );
+            else
+                mid ( child, add ( th_pn_ - node.pn, best_pn ), std::min ( th_dn_, add ( second, 1 ) ) );
+        }
+        node.work = add ( node.work, static_cast<Number> ( std::min<std::int64_t> ( m_expanded - expanded, infinity ) ) );
+        m_table.put ( node );
+    }
+
+    TranspositionTable & m_table;
+    std::atomic<std::int64_t> & m_nodes;
+    std::int64_t const m_max_nodes;
+    typename State::value_type const m_attacker;
+    int const m_tie_break;
+    std::int64_t m_expanded = 0; // by this thread.
+};
+
+// Tries to prove that the player to move in root_state_ wins.
+template<typename State>
+[[nodiscard]] Result<typename State::Move> solve ( State const & root_state_, ComputeOptions const & options_ ) {
+    Result<typename State::Move> result;
+    result.move = State::no_move;
+    if ( root_state_.terminal ( ) )
+        return result;
+    TranspositionTable table ( options_.table_size );
+    std::atomic<std::int64_t> nodes{ 0 };
+    std::vector<std::future<void>> helpers;
+    for ( int t = 1; t < options_.number_of_threads; ++t )
+        helpers.push_back ( std::async ( std::launch::async, [ t, &root_state_, &table, &nodes, &options_ ] ( ) {
+            Solver<State> ( table, nodes, options_.max_nodes, root_state_.playerToMove ( ), t ).solve ( root_state_ );
+        } ) );
+    Solver<State> ( table, nodes, options_.max_nodes, root_state_.playerToMove ( ), 0 ).solve ( root_state_ );
+    // All threads stop once the root is solved, or the budget is spent.
+    for ( auto & helper : helpers )
+        helper.wait ( );
+    TranspositionTable::Entry const root = table.get ( key ( root_state_ ) );
+    result.value = not root.pn ? Value::proven : not root.dn ? Value::disproven : Value::unknown;
+    result.nodes = nodes.load ( std::memory_order_relaxed );
+    if ( Value::proven == result.value ) {
+        for ( auto const move : root_state_.availableMoves ( ) ) {
+            State child = root_state_;
+            child.moveWinner ( move );
+            if ( not table.get ( key ( child ) ).pn ) {
+                result.move = move;
+                break;
+            }
+        }
+        // The winning child might have been replaced in the table, extremely unlikely.
+        if ( State::no_move == result.move )
+            result.value = Value::unknown;
+    }
+    if ( options_.verbose ) {
+        constexpr char const * names[ 3 ]{ "unknown", "proven", "disproven" };
+        std::cerr << "df-pn " << names[ static_cast<int> ( result.value ) ] << " in " << result.nodes << " nodes" << std::endl;
+    }
+    return result;
+}
+
+} // namespace ProofNumber
@@ -0,0 +1,298 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Sampling of records (positions) by any number of (search) threads, that never waits.
+// Every thread fills blocks of records from a small pool of its own (a bounded ring),
+// a full block is passed to the writer thread over a lock-free (intrusive, Vyukov) MPSC
+// queue, the writer appends the records to a Segment::Log and returns the block to the
+// pool of its thread. A thread whose pool is empty (the writer is behind) drops its
+// records, and counts them. Threads that end hand in their partial block, and their
+// pool is taken over by the next new thread. One Sampler per Record type.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <chrono>
+#include <filesystem>
+#include <memory>
+#include <new>
+#include <thread>
+
+#include "SegmentLog.hpp"
+
+namespace Sampling {
+
+struct Stats {
+    std::uint64_t sampled = 0u, dropped = 0u, written = 0u;
+    std::size_t in_flight = 0u, max_in_flight = 0u; // blocks queued, but not written.
+};
+
+template<typename Record, std::size_t BlockSize = 256u, std::size_t Blocks = 16u>
+class Sampler {
+
+    static_assert ( Blocks and not( Blocks & ( Blocks - 1u ) ), "the pool is a ring of a power of 2" );
+
+    struct Pool;
+
+    struct Block {
+        std::atomic<Block *> next{ nullptr };
+        Pool * pool      = nullptr;
+        std::size_t size = 0u;
+        Record records[ BlockSize ];
+    };
+
+    // The blocks of a thread, the free blocks are in a single producer (the writer),
+    // single consumer (the owner) ring.
+    struct alignas ( 64 ) Pool {
+        std::array<Block, Blocks> blocks;
+        std::array<Block *, Blocks> free;
+        alignas ( 64 ) std::atomic<std::size_t> head{ 0u }; // popped by the owner.
+        alignas ( 64 ) std::atomic<std::size_t> tail{ 0u }; // pushed by the writer.
+        Block * current = nullptr;
+        std::atomic<std::uint64_t> sampled{ 0u }, dropped{ 0u }; // only written by the owner.
+        std::atomic<bool> owned{ true };
+        Pool * next = nullptr;
+
+        Pool ( ) noexcept {
+            for ( std::size_t i = 0u; i < Blocks; ++i ) {
+                blocks[ i ].pool = this;
+                free[ i ]        = std::addressof ( blocks[ i ] );
+            }
+            tail.store ( Blocks, std::memory_order_relaxed );
+        }
+
+        [[nodiscard]] Block * pop ( ) noexcept {
+            std::size_t const h = head.load ( std::memory_order_relaxed );
+            if ( h == tail.load ( std::memory_order_acquire ) )
+                return nullptr;
+            Block * const b = free[ h & ( Blocks - 1u ) ];
+            head.store ( h + 1u, std::memory_order_release );
+            return b;
+        }
+
+        void push ( Block * const b_ ) noexcept { // Never full, there are only Blocks blocks.
+            std::size_t const t         = tail.load ( std::memory_order_relaxed );
+            free[ t & ( Blocks - 1u ) ] = b_;
+            tail.store ( t + 1u, std::memory_order_release );
+        }
+    };
+
+    // Hands in the partial block, and gives up the pool, at the end of the thread.
+    struct Handle {
+        Sampler * sampler = nullptr;
+        Pool * pool       = nullptr;
+
+        ~Handle ( ) noexcept {
+            if ( not pool )
+                return;
+            if ( pool->current and pool->current->size ) {
+                sampler->submit ( pool->current );
+                pool->current = nullptr;
+            }
+            pool->owned.store ( false, std::memory_order_release );
+        }
+    };
+
+    public:
+    Sampler ( ) noexcept { m_head.store ( std::addressof ( m_stub ), std::memory_order_relaxed ); }
+    Sampler ( Sampler const & ) = delete;
+    Sampler ( Sampler && )      = delete;
+
+    ~Sampler ( ) noexcept {
+        stop ( );
+        for ( Pool * p = m_pools.load ( std::memory_order_acquire ); p; ) {
+            Pool * const next = p->next;
+            delete p;
+            p = next;
+        }
+    }
+
+    Sampler & operator= ( Sampler const & ) = delete;
+    Sampler & operator= ( Sampler && ) = delete;
+
+    // Starts the writer, appending to a Segment::Log in directory_, sampling does nothing
+    // before.
+    void start ( std::filesystem::path const & directory_, std::size_t const segment_size_ = std::size_t{ 1 } << 26 ) {
+        stop ( );
+        m_log.open ( directory_, segment_size_, BlockSize * sizeof ( Record ) * Blocks );
+        m_stop.store ( false, std::memory_order_relaxed );
+        m_writer = std::thread ( [ this ] ( ) { write ( ); } );
+        m_running.store ( true, std::memory_order_release );
+    }
+
+    // Writes the queued blocks, and stops the writer.
+    void stop ( ) noexcept {
+        if ( not m_writer.joinable ( ) )
+            return;
+        m_running.store ( false, std::memory_order_relaxed );
+        m_stop.store ( true, std::memory_order_release );
+        m_writer.join ( );
+        try {
+            m_log.close ( );
+        }
+        catch ( ... ) {
+        }
+    }
+
+    // Never waits, drops the record iff the pool of the thread is empty.
+    void push ( Record const & record_ ) noexcept {
+        if ( not m_running.load ( std::memory_order_relaxed ) )
+            return;
+        Pool * const pool = this_pool ( );
+        if ( not pool )
+            return;
+        if ( not pool->current ) {
+            pool->current = pool->pop ( );
+            if ( not pool->current ) {
+                pool->dropped.store ( pool->dropped.load ( std::memory_order_relaxed ) + 1u, std::memory_order_relaxed );
+                return;
+            }
+            pool->current->size = 0u;
+        }
+        std::memcpy ( pool->current->records + pool->current->size, &record_, sizeof ( Record ) );
+        pool->sampled.store ( pool->sampled.load ( std::memory_order_relaxed ) + 1u, std::memory_order_relaxed );
+        if ( ++pool->current->size == BlockSize ) {
+            submit ( pool->current );
+            pool->current = nullptr;
+        }
+    }
+
+    [[nodiscard]] Stats stats ( ) const noexcept {
+        Stats s;
+        for ( Pool const * p = m_pools.load ( std::memory_order_acquire ); p; p = p->next ) {
+            s.sampled += p->sampled.load ( std::memory_order_relaxed );
+            s.dropped += p->dropped.load ( std::memory_order_relaxed );
+        }
+        s.written       = m_written.load ( std::memory_order_relaxed );
+        s.in_flight     = m_in_flight.load ( std::memory_order_relaxed );
+        s.max_in_flight = m_max_in_flight.load ( std::memory_order_relaxed );
+        return s;
+    }
+
+    private:
+    // The pool of this thread, taken over from an ended thread, or new (nullptr, iff out
+    // of memory).
+    [[nodiscard]] Pool * this_pool ( ) noexcept {
+        static thread_local Handle handle;
+        if ( handle.pool )
+            return handle.pool;
+        for ( Pool * p = m_pools.load ( std::memory_order_acquire ); p; p = p->next ) {
+            bool owned = false;
+            if ( not p->owned.load ( std::memory_order_relaxed ) and
+                 p->owned.compare_exchange_strong ( owned, true, std::memory_order_acquire ) ) {
+                handle.sampler = this;
+                handle.pool    = p;
+                return p;
+            }
+        }
+        Pool * const p = new ( std::nothrow ) Pool;
+        if ( not p )
+            return nullptr;
+        p->next = m_pools.load ( std::memory_order_relaxed );
+        while ( not m_pools.compare_exchange_weak ( p->next, p, std::memory_order_release, std::memory_order_relaxed ) )
+            ;
+        handle.sampler = this;
+        handle.pool    = p;
+        return p;
+    }
+
+    // The MPSC queue, wait-free for the producers.
+    void submit ( Block * const b_ ) noexcept {
+        m_in_flight.fetch_add ( 1u, std::memory_order_relaxed );
+        enqueue ( b_ );
+    }
+
+    void enqueue ( Block * const b_ ) noexcept {
+        b_->next.store ( nullptr, std::memory_order_relaxed );
+        Block * const prev = m_head.exchange ( b_, std::memory_order_acq_rel );
+        prev->next.store ( b_, std::memory_order_release );
+    }
+
+    // Only by the writer, nullptr iff empty (or a push is half way).
+    [[nodiscard]] Block * dequeue ( ) noexcept {
+        Block * tail = m_tail;
+        Block * next = tail->next.load ( std::memory_order_acquire );
+        if ( std::addressof ( m_stub ) == tail ) {
+            if ( not next )
+                return nullptr;
+            m_tail = tail = next;
+            next          = next->next.load ( std::memory_order_acquire );
+        }
+        if ( next ) {
+            m_tail = next;
+            return tail;
+        }
+        if ( tail != m_head.load ( std::memory_order_acquire ) )
+            return nullptr;
+        enqueue ( std::addressof ( m_stub ) );
+        next = tail->next.load ( std::memory_order_acquire );
+        if ( next ) {
+            m_tail = next;
+            return tail;
+        }
+        return nullptr;
+    }
+
+    void write ( ) noexcept {
+        while ( true ) {
+            bool const stop             = m_stop.load ( std::memory_order_acquire );
+            std::size_t const in_flight = m_in_flight.load ( std::memory_order_relaxed );
+            if ( in_flight > m_max_in_flight.load ( std::memory_order_relaxed ) )
+                m_max_in_flight.store ( in_flight, std::memory_order_relaxed );
+            std::size_t n = 0u;
+            for ( Block * b; ( b = dequeue ( ) ); ++n ) {
+                try {
+                    for ( std::size_t i = 0u; i < b->size; ++i )
+                        m_log.append ( b->records[ i ] );
+                    m_written.fetch_add ( b->size, std::memory_order_relaxed );
+                }
+                catch ( ... ) { // The records are lost, the search carries on.
+                }
+                m_in_flight.fetch_sub ( 1u, std::memory_order_relaxed );
+                b->pool->push ( b );
+            }
+            if ( stop and not n )
+                return;
+            if ( not n )
+                std::this_thread::sleep_for ( std::chrono::milliseconds ( 1 ) );
+        }
+    }
+
+    Segment::Log<Record> m_log;
+    std::thread m_writer;
+    std::atomic<bool> m_running{ false }, m_stop{ false };
+    std::atomic<Pool *> m_pools{ nullptr };
+    alignas ( 64 ) std::atomic<Block *> m_head{ nullptr }; // the producers' end of the queue.
+    alignas ( 64 ) Block * m_tail = std::addressof ( m_stub );
+    Block m_stub;
+    std::atomic<std::uint64_t> m_written{ 0u };
+    std::atomic<std::size_t> m_in_flight{ 0u }, m_max_in_flight{ 0u };
+};
+
+} // namespace Sampling
@@ -0,0 +1,254 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// An append-only log of fixed size (trivially copyable) records, in segments of a
+// maximum size, in a directory. The records are copied into a buffer, that is written
+// to the current segment when full, so appending costs about one memcpy. The index
+// (the file "index" in the directory) has an entry for every complete segment, a new
+// log in the same directory continues after the last indexed segment (overwriting the
+// segment of a log that was not closed).
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstring>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <iterator>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Segment {
+
+// | magic 8 | version 4 | record size 4 | segment 8 | first record 8 | reserved 32 |,
+// followed by the records.
+struct Header {
+    char magic[ 8 ]            = { 'M', 'A', 'D', 'O', 'S', 'E', 'G', '\0' };
+    std::uint32_t version      = 1u;
+    std::uint32_t record_size  = 0u;
+    std::uint64_t segment      = 0u;
+    std::uint64_t first        = 0u; // the number of the first record, in the log.
+    std::uint8_t reserved[ 32 ] = { };
+};
+
+static_assert ( sizeof ( Header ) == 64, "the records have to start at a 64 byte boundary" );
+
+struct IndexEntry {
+    std::uint64_t segment = 0u, first = 0u, records = 0u;
+};
+
+[[nodiscard]] inline std::filesystem::path segment_path ( std::filesystem::path const & directory_, std::uint64_t const segment_ ) {
+    char name[ 32 ];
+    std::snprintf ( name, sizeof ( name ), "%08llu.seg", static_cast<unsigned long long> ( segment_ ) );
+    return directory_ / name;
+}
+
+[[nodiscard]] inline std::filesystem::path index_path ( std::filesystem::path const & directory_ ) { return directory_ / "index"; }
+
+template<typename Record>
+class Log {
+
+    static_assert ( std::is_trivially_copyable<Record>::value, "records are written as they are in memory" );
+
+    public:
+    Log ( ) noexcept = default;
+    explicit Log ( std::filesystem::path const & directory_, std::size_t const segment_size_ = std::size_t{ 1 } << 26,
+                   std::size_t const buffer_size_ = std::size_t{ 1 } << 20 ) {
+        open ( directory_, segment_size_, buffer_size_ );
+    }
+    Log ( Log const & ) = delete;
+    Log ( Log && )      = delete;
+
+    ~Log ( ) noexcept {
+        try {
+            close ( );
+        }
+        catch ( ... ) {
+        }
+    }
+
+    Log & operator= ( Log const & ) = delete;
+    Log & operator= ( Log && ) = delete;
+
+    // The sizes are in bytes, rounded down to whole records (at least one).
+    void open ( std::filesystem::path const & directory_, std::size_t const segment_size_ = std::size_t{ 1 } << 26,
+                std::size_t const buffer_size_ = std::size_t{ 1 } << 20 ) {
+        close ( );
+        std::filesystem::create_directories ( directory_ );
+        m_directory        = directory_;
+        m_segment_capacity = std::max ( segment_size_ / sizeof ( Record ), std::size_t{ 1 } );
+        m_buffer_capacity  = std::clamp ( buffer_size_ / sizeof ( Record ), std::size_t{ 1 }, m_segment_capacity );
+        m_buffer           = std::make_unique<Record[]> ( m_buffer_capacity );
+        m_buffered         = 0u;
+        m_segment          = 0u;
+        m_records          = 0u;
+        if ( std::ifstream index ( index_path ( m_directory ), std::ios::binary ); index ) {
+            for ( IndexEntry e; index.read ( reinterpret_cast<char *> ( &e ), sizeof ( IndexEntry ) ); ) {
+                m_segment = e.segment + 1u;
+                m_records = e.first + e.records;
+            }
+        }
+        start_segment ( );
+    }
+
+    [[nodiscard]] bool is_open ( ) const noexcept { return static_cast<bool> ( m_buffer ); }
+
+    // Does nothing, iff the log is not open.
+    void append ( Record const & record_ ) {
+        if ( not m_buffer )
+            return;
+        std::memcpy ( m_buffer.get ( ) + m_buffered, &record_, sizeof ( Record ) );
+        if ( ++m_buffered == m_buffer_capacity )
+            flush ( );
+    }
+
+    // Writes the buffered records, the segment is rotated when full.
+    void flush ( ) {
+        std::size_t written = 0u;
+        while ( written < m_buffered ) {
+            std::size_t const n = std::min ( m_buffered - written, m_segment_capacity - m_segment_records );
+            m_file.write ( reinterpret_cast<char const *> ( m_buffer.get ( ) + written ),
+                           static_cast<std::streamsize> ( n * sizeof ( Record ) ) );
+            if ( not m_file )
+                throw std::runtime_error ( "Segment: cannot write " + segment_path ( m_directory, m_segment ).string ( ) );
+            written += n;
+            m_segment_records += n;
+            if ( m_segment_records == m_segment_capacity ) {
+                end_segment ( );
+                ++m_segment;
+                start_segment ( );
+            }
+        }
+        m_buffered = 0u;
+        m_file.flush ( );
+    }
+
+    // Writes the buffered records, and indexes the last segment (iff not empty).
+    void close ( ) {
+        if ( not m_buffer )
+            return;
+        flush ( );
+        bool const empty = not m_segment_records;
+        end_segment ( );
+        if ( empty )
+            std::filesystem::remove ( segment_path ( m_directory, m_segment ) );
+        m_buffer.reset ( );
+    }
+
+    // The number of records appended, in this and the previous logs of the directory.
+    [[nodiscard]] std::uint64_t records ( ) const noexcept { return m_records + m_segment_records + m_buffered; }
+    [[nodiscard]] std::filesystem::path const & directory ( ) const noexcept { return m_directory; }
+
+    private:
+    void start_segment ( ) {
+        std::filesystem::path const path = segment_path ( m_directory, m_segment );
+        m_file.open ( path, std::ios::binary | std::ios::trunc );
+        if ( not m_file )
+            throw std::runtime_error ( "Segment: cannot write " + path.string ( ) );
+        Header header;
+        header.record_size = static_cast<std::uint32_t> ( sizeof ( Record ) );
+        header.segment     = m_segment;
+        header.first       = m_records;
+        m_file.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+        m_segment_records = 0u;
+    }
+
+    void end_segment ( ) {
+        m_file.close ( );
+        if ( not m_segment_records )
+            return;
+        std::ofstream index ( index_path ( m_directory ), std::ios::binary | std::ios::app );
+        IndexEntry const e{ m_segment, m_records, m_segment_records };
+        if ( not index.write ( reinterpret_cast<char const *> ( &e ), sizeof ( IndexEntry ) ) )
+            throw std::runtime_error ( "Segment: cannot write " + index_path ( m_directory ).string ( ) );
+        m_records += m_segment_records;
+        m_segment_records = 0u;
+    }
+
+    std::filesystem::path m_directory;
+    std::ofstream m_file;
+    std::unique_ptr<Record[]> m_buffer;
+    std::size_t m_buffer_capacity = 0u, m_buffered = 0u;
+    std::size_t m_segment_capacity = 0u, m_segment_records = 0u;
+    std::uint64_t m_segment = 0u, m_records = 0u;
+};
+
+// The index of the log in directory_.
+[[nodiscard]] inline std::vector<IndexEntry> read_index ( std::filesystem::path const & directory_ ) {
+    std::vector<IndexEntry> index;
+    std::ifstream istream ( index_path ( directory_ ), std::ios::binary );
+    if ( not istream )
+        throw std::runtime_error ( "Segment: cannot read " + index_path ( directory_ ).string ( ) );
+    for ( IndexEntry e; istream.read ( reinterpret_cast<char *> ( &e ), sizeof ( IndexEntry ) ); )
+        index.push_back ( e );
+    return index;
+}
+
+// n_ records drawn (with replacement) uniformly from the indexed segments of the log in
+// directory_, in the order of the log.
+template<typename Record>
+[[nodiscard]] std::vector<Record> sample ( std::filesystem::path const & directory_, std::size_t const n_,
+                                           std::uint64_t const seed_ = 0u ) {
+    std::vector<IndexEntry> const index = read_index ( directory_ );
+    std::vector<Record> records;
+    if ( index.empty ( ) or not n_ )
+        return records;
+    std::uint64_t const size = index.back ( ).first + index.back ( ).records;
+    std::vector<std::uint64_t> picks ( n_ );
+    std::mt19937_64 rng ( seed_ );
+    for ( auto & p : picks )
+        p = std::uniform_int_distribution<std::uint64_t> ( 0u, size - 1u ) ( rng );
+    std::sort ( std::begin ( picks ), std::end ( picks ) );
+    records.resize ( n_ );
+    std::ifstream istream;
+    auto segment = std::end ( index );
+    for ( std::size_t i = 0u; i < n_; ++i ) {
+        auto const s = std::prev ( std::upper_bound (
+            std::begin ( index ), std::end ( index ), picks[ i ],
+            [] ( std::uint64_t const r_, IndexEntry const & e_ ) noexcept { return r_ < e_.first; } ) );
+        if ( s != segment ) {
+            segment                          = s;
+            std::filesystem::path const path = segment_path ( directory_, s->segment );
+            istream.close ( );
+            istream.open ( path, std::ios::binary );
+            Header header;
+            if ( not istream.read ( reinterpret_cast<char *> ( &header ), sizeof ( Header ) ) or
+                 sizeof ( Record ) != header.record_size )
+                throw std::runtime_error ( "Segment: wrong segment " + path.string ( ) );
+        }
+        istream.seekg ( static_cast<std::streamoff> ( sizeof ( Header ) + ( picks[ i ] - s->first ) * sizeof ( Record ) ) );
+        if ( not istream.read ( reinterpret_cast<char *> ( records.data ( ) + i ), sizeof ( Record ) ) )
+            throw std::runtime_error ( "Segment: cannot read " + segment_path ( directory_, s->segment ).string ( ) );
+    }
+    return records;
+}
+
+} // namespace Segment
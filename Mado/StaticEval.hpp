@@ -0,0 +1,123 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A static evaluation of Mado<R>, linear in the features the state keeps up to date
+// (Mado::Features), so it costs a few multiplications. The weights (fitted to the
+// outcome of random playouts) are read from a text file of "name value" lines.
+
+#pragma once
+
+#include <cmath>
+#include <cstddef>
+
+#include <algorithm>
+#include <array>
+#include <filesystem>
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+
+namespace StaticEval {
+
+// Fitted (at R = 3) to predict the outcome of random playouts, i.e. for playout cutoffs.
+struct Weights {
+
+    float liberties            = 0.01f; // per stone, own less opponent's.
+    float own_one_liberty      = -0.27f;
+    float opponent_one_liberty = 0.25f;
+    float edges                = -0.03f; // own less opponent's.
+    float frontier             = 0.02f; // own less opponent's.
+    float stones               = -0.03f; // own less opponent's.
+    float to_move              = 0.0f;
+    float slides               = 0.4f; // the fraction of the score lost at the sixth slide.
+
+    struct Entry {
+        std::string_view name;
+        float Weights::*weight;
+    };
+
+    static constexpr std::array<Entry, 8> entries = { Entry{ "liberties", &Weights::liberties },
+                                                      Entry{ "own_one_liberty", &Weights::own_one_liberty },
+                                                      Entry{ "opponent_one_liberty", &Weights::opponent_one_liberty },
+                                                      Entry{ "edges", &Weights::edges },
+                                                      Entry{ "frontier", &Weights::frontier },
+                                                      Entry{ "stones", &Weights::stones },
+                                                      Entry{ "to_move", &Weights::to_move },
+                                                      Entry{ "slides", &Weights::slides } };
+
+    // Missing weights keep their value, # starts a comment.
+    void load ( std::filesystem::path const & path_ ) {
+        std::ifstream istream ( path_ );
+        if ( not istream )
+            throw std::runtime_error ( "StaticEval: cannot read " + path_.string ( ) );
+        for ( std::string line; std::getline ( istream, line ); ) {
+            line = line.substr ( 0, line.find ( '#' ) );
+            std::istringstream words ( line );
+            std::string name;
+            float value;
+            if ( not( words >> name ) )
+                continue;
+            auto const entry = std::find_if ( std::begin ( entries ), std::end ( entries ),
+                                              [ &name ] ( Entry const & e_ ) noexcept { return e_.name == name; } );
+            if ( std::end ( entries ) == entry or not( words >> value ) )
+                throw std::runtime_error ( "StaticEval: bad line \"" + line + "\" in " + path_.string ( ) );
+            this->*entry->weight = value;
+        }
+    }
+
+    void save ( std::filesystem::path const & path_ ) const {
+        std::ofstream ostream ( path_, std::ios::trunc );
+        if ( not ostream )
+            throw std::runtime_error ( "StaticEval: cannot write " + path_.string ( ) );
+        for ( auto const & e : entries )
+            ostream << e.name << ' ' << this->*e.weight << '\n';
+    }
+};
+
+inline constexpr Weights default_weights{ };
+
+// The score of the position, for the player to move, in logits of winning.
+template<typename State>
+[[nodiscard]] float evaluate ( State const & state_, Weights const & w_ = default_weights ) noexcept {
+    auto const & f = state_.features ( );
+    int const own = state_.playerToMove ( ).as_01index ( ), opponent = 1 - own;
+    auto per_stone = [ &f ] ( int const p_ ) noexcept {
+        return f.stones[ p_ ] ? static_cast<float> ( f.liberties[ p_ ] ) / static_cast<float> ( f.stones[ p_ ] ) : 0.0f;
+    };
+    float const score = w_.liberties * ( per_stone ( own ) - per_stone ( opponent ) ) +
+                        w_.own_one_liberty * f.one_liberty[ own ] + w_.opponent_one_liberty * f.one_liberty[ opponent ] +
+                        w_.edges * ( f.edges[ own ] - f.edges[ opponent ] ) +
+                        w_.frontier * ( f.frontier[ own ] - f.frontier[ opponent ] ) +
+                        w_.stones * ( f.stones[ own ] - f.stones[ opponent ] ) + w_.to_move;
+    return score * ( 1.0f - w_.slides * static_cast<float> ( state_.position ( ).m_slides ) / 6.0f );
+}
+
+// The probability that the player to move wins (a draw counting as half a win).
+template<typename State>
+[[nodiscard]] float win_probability ( State const & state_, Weights const & w_ = default_weights ) noexcept {
+    return 1.0f / ( 1.0f + std::exp ( -evaluate ( state_, w_ ) ) );
+}
+
+} // namespace StaticEval
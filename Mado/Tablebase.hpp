@@ -0,0 +1,345 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// A complete win/draw/loss table for the smallest board (R = 2, 19 cells), built by
+// backward induction (retrograde analysis). A placement adds a stone and a slide
+// increases the slide count, so the game graph has no cycles. The positions are
+// solved in layers of decreasing number of stones, and within a layer by decreasing
+// slide count, every child is then already solved. All positions of a slice are
+// independent, so they're solved in parallel.
+//
+// The table has 2 bits per position, indexed by a perfect index over PositionData<R>,
+// and is read through a memory mapping, a probe is an index computation and a lookup.
+
+#pragma once
+
+#include <cassert>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <cstring>
+
+#include <algorithm>
+#include <array>
+#include <atomic>
+#include <filesystem>
+#include <fstream>
+#include <iostream>
+#include <memory>
+#include <random>
+#include <stdexcept>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include "Mado.hpp"
+#include "MappedFile.hpp"
+#include "ProofNumber.hpp"
+
+namespace Tablebase {
+
+// Of the player to move, unknown is a position that was not solved.
+enum class WDL : std::uint8_t { unknown = 0, loss, draw, win };
+
+[[nodiscard]] constexpr WDL flip ( WDL const v_ ) noexcept {
+    return WDL::win == v_ ? WDL::loss : WDL::loss == v_ ? WDL::win : v_;
+}
+
+// The perfect index. The positions are ordered in layers by the number of stones n,
+// within a layer in 12 slices by slide count (0 to 5) and player to move, within a
+// slice by the (colex) rank of the set of occupied cells and the colors of the stones,
+// a slice of layer n has C ( cells, n ) * 2^n positions (rounded up to whole bytes).
+template<int R>
+struct Index {
+
+    using PositionData = PositionData<R>;
+    using Board        = typename PositionData::Board;
+    using Player       = typename PositionData::value_type;
+
+    static constexpr int cells  = Board::size ( );
+    static constexpr int slices = 12;
+
+    static_assert ( cells <= 37, "the index does not fit in 64 bits" );
+
+    struct Tables {
+        std::array<std::array<std::uint64_t, cells + 1>, cells + 1> binomial{ };
+        std::array<std::uint64_t, cells + 1> slice_size{ };
+        std::array<std::uint64_t, cells + 2> layer_offset{ };
+    };
+
+    [[nodiscard]] static Tables const & tables ( ) noexcept {
+        static Tables const t = [] ( ) {
+            Tables t;
+            for ( int n = 0; n <= cells; ++n ) {
+                t.binomial[ n ][ 0 ] = 1u;
+                for ( int k = 1; k <= n; ++k )
+                    t.binomial[ n ][ k ] = t.binomial[ n - 1 ][ k - 1 ] + ( k < n ? t.binomial[ n - 1 ][ k ] : 0u );
+            }
+            for ( int n = 0; n <= cells; ++n ) {
+                t.slice_size[ n ]       = ( ( t.binomial[ cells ][ n ] << n ) + 3u ) & ~std::uint64_t{ 3 };
+                t.layer_offset[ n + 1 ] = t.layer_offset[ n ] + slices * t.slice_size[ n ];
+            }
+            return t;
+        }( );
+        return t;
+    }
+
+    [[nodiscard]] static std::uint64_t size ( ) noexcept { return tables ( ).layer_offset[ cells + 1 ]; }
+
+    [[nodiscard]] static std::uint64_t slice_offset ( int const n_, int const slice_ ) noexcept {
+        return tables ( ).layer_offset[ n_ ] + static_cast<std::uint64_t> ( slice_ ) * tables ( ).slice_size[ n_ ];
+    }
+
+    [[nodiscard]] static int slice ( int const slides_, Player const player_to_move_ ) noexcept {
+        return 2 * slides_ + player_to_move_.as_01index ( );
+    }
+
+    [[nodiscard]] static std::uint64_t index ( PositionData const & p_ ) noexcept {
+        Tables const & t   = tables ( );
+        std::uint64_t set  = 0u, colors = 0u;
+        int n              = 0;
+        for ( int c = 0; c < cells; ++c ) {
+            if ( p_.m_board[ c ].occupied ( ) ) {
+                colors |= static_cast<std::uint64_t> ( p_.m_board[ c ].agent ( ) ) << n;
+                set += t.binomial[ c ][ ++n ];
+            }
+        }
+        return slice_offset ( n, slice ( p_.m_slides, p_.m_player_to_move ) ) + ( set << n ) + colors;
+    }
+
+    // The position at rank_ in the slice_ of layer n_.
+    [[nodiscard]] static PositionData position ( int const n_, int const slice_, std::uint64_t const rank_ ) noexcept {
+        Tables const & t = tables ( );
+        PositionData p; // A vacant board.
+        p.m_slides               = static_cast<std::int8_t> ( slice_ / 2 );
+        p.m_player_to_move       = slice_ & 1 ? Player::Type::human : Player::Type::agent;
+        std::uint64_t set        = rank_ >> n_;
+        std::uint64_t const colors = rank_ & ( ( std::uint64_t{ 1 } << n_ ) - 1u );
+        int c                    = cells;
+        for ( int k = n_; k > 0; --k ) {
+            do
+                --c;
+            while ( t.binomial[ c ][ k ] > set );
+            set -= t.binomial[ c ][ k ];
+            p.m_board[ c ] = ( colors >> ( k - 1 ) ) & 1u ? Player::Type::agent : Player::Type::human;
+        }
+        return p;
+    }
+};
+
+// | magic 8 | version 4 | radius 4 | entries 8 | reserved 40 |, followed by the table.
+struct Header {
+    char magic[ 8 ]        = { 'M', 'A', 'D', 'O', 'W', 'D', 'L', '\0' };
+    std::uint32_t version  = 1u;
+    std::uint32_t radius   = 0u;
+    std::uint64_t entries  = 0u;
+    std::uint8_t reserved[ 40 ] = { };
+};
+
+static_assert ( sizeof ( Header ) == 64, "the table has to start at a 64 byte boundary" );
+
+[[nodiscard]] inline WDL get ( std::uint8_t const * bits_, std::uint64_t const i_ ) noexcept {
+    return static_cast<WDL> ( ( bits_[ i_ >> 2 ] >> ( ( i_ & 3u ) << 1 ) ) & 3u );
+}
+
+// The value of the position after move_, for the player making the move.
+template<int R>
+[[nodiscard]] WDL value_after ( Mado<R> const & state_, typename Mado<R>::Move const move_, std::uint8_t const * bits_ ) noexcept {
+    Mado<R> child = state_;
+    child.moveWinner ( move_ );
+    if ( child.terminal ( ) )
+        return child.winner ( ).vacant ( ) ? WDL::draw : child.winner ( ) == state_.playerToMove ( ) ? WDL::win : WDL::loss;
+    return flip ( get ( bits_, Index<R>::index ( child.position ( ) ) ) );
+}
+
+template<int R>
+class Builder {
+
+    public:
+    using Index = Index<R>;
+
+    explicit Builder ( int const number_of_threads_ = static_cast<int> ( std::thread::hardware_concurrency ( ) ) ) :
+        m_number_of_threads ( std::max ( number_of_threads_, 1 ) ),
+        // calloc, the pages of layers that are not (yet) solved are not touched.
+        m_bits ( static_cast<std::uint8_t *> ( std::calloc ( Index::size ( ) / 4u, 1u ) ), &std::free ) {
+        if ( not m_bits )
+            throw std::runtime_error ( "Tablebase: out of memory" );
+    }
+
+    // Solves layer n_, the layers with more stones have to be solved already.
+    void solve_layer ( int const n_ ) {
+        for ( int slides = 5; slides >= 0; --slides ) {
+            for ( int player = 0; player < 2; ++player ) {
+                int const slice          = 2 * slides + player;
+                std::uint64_t const size = std::uint64_t{ Index::tables ( ).binomial[ Index::cells ][ n_ ] } << n_;
+                std::atomic<std::uint64_t> next{ 0u };
+                auto work = [ & ] ( ) {
+                    // Chunks of whole bytes, as the slices start at a byte boundary, no two threads write to the same byte.
+                    constexpr std::uint64_t chunk = 4'096u;
+                    for ( std::uint64_t b; ( b = next.fetch_add ( chunk, std::memory_order_relaxed ) ) < size; )
+                        for ( std::uint64_t r = b, e = std::min ( b + chunk, size ); r < e; ++r )
+                            set ( Index::slice_offset ( n_, slice ) + r, solve ( Index::position ( n_, slice, r ) ) );
+                };
+                std::vector<std::thread> threads;
+                for ( int t = 1; t < m_number_of_threads; ++t )
+                    threads.emplace_back ( work );
+                work ( );
+                for ( auto & thread : threads )
+                    thread.join ( );
+            }
+        }
+    }
+
+    void solve ( bool const verbose_ = true ) {
+        for ( int n = Index::cells; n >= 0; --n ) {
+            solve_layer ( n );
+            if ( verbose_ )
+                std::cerr << "layer " << n << " solved" << std::endl;
+        }
+    }
+
+    // Cross-checks samples_ random positions of the solved layer n_ against df-pn (with a
+    // budget of max_nodes_ each), a position df-pn proves has to be a win, with a winning
+    // move, one it disproves cannot be a win. Throws on a mismatch, returns the number of
+    // positions df-pn solved.
+    int verify_layer ( int const n_, int const samples_, std::uint64_t const seed_,
+                       std::int64_t const max_nodes_ = 100'000 ) const {
+        std::mt19937_64 engine ( seed_ );
+        std::uint64_t const size = std::uint64_t{ Index::tables ( ).binomial[ Index::cells ][ n_ ] } << n_;
+        ProofNumber::ComputeOptions options;
+        options.number_of_threads = m_number_of_threads;
+        options.max_nodes         = max_nodes_;
+        int solved                = 0;
+        for ( int s = 0; s < samples_; ++s ) {
+            int const slice = std::uniform_int_distribution<int> ( 0, Index::slices - 1 ) ( engine );
+            if ( not n_ and slice > 1 )
+                continue; // Unreachable, sliding without stones.
+            std::uint64_t const rank = std::uniform_int_distribution<std::uint64_t> ( 0u, size - 1u ) ( engine );
+            Mado<R> const state ( Index::position ( n_, slice, rank ) );
+            WDL const v = value ( state );
+            auto const r = ProofNumber::solve ( state, options );
+            if ( ProofNumber::Value::unknown == r.value )
+                continue;
+            ++solved;
+            if ( WDL::unknown == v or ( ProofNumber::Value::proven == r.value ) != ( WDL::win == v ) or
+                 ( ProofNumber::Value::proven == r.value and WDL::win != value_after ( state, r.move, m_bits.get ( ) ) ) )
+                throw std::runtime_error ( "Tablebase: df-pn disagrees on position " +
+                                           std::to_string ( Index::index ( state.position ( ) ) ) );
+        }
+        return solved;
+    }
+
+    // As verify_layer ( ), samples_ positions of every layer.
+    int verify ( int const samples_, std::uint64_t const seed_, bool const verbose_ = true ) const {
+        int solved = 0;
+        for ( int n = Index::cells; n >= 0; --n ) {
+            int const s = verify_layer ( n, samples_, seed_ + static_cast<std::uint64_t> ( n ) );
+            if ( verbose_ )
+                std::cerr << "layer " << n << " " << s << " of " << samples_ << " solved by df-pn, all agree" << std::endl;
+            solved += s;
+        }
+        return solved;
+    }
+
+    void save ( std::filesystem::path const & path_ ) const {
+        std::ofstream ostream ( path_, std::ios::binary | std::ios::trunc );
+        if ( not ostream )
+            throw std::runtime_error ( "Tablebase: cannot write " + path_.string ( ) );
+        Header header;
+        header.radius  = static_cast<std::uint32_t> ( R );
+        header.entries = Index::size ( );
+        ostream.write ( reinterpret_cast<char const *> ( &header ), sizeof ( Header ) );
+        ostream.write ( reinterpret_cast<char const *> ( m_bits.get ( ) ), static_cast<std::streamsize> ( Index::size ( ) / 4u ) );
+    }
+
+    [[nodiscard]] WDL value ( Mado<R> const & state_ ) const noexcept {
+        return get ( m_bits.get ( ), Index::index ( state_.position ( ) ) );
+    }
+
+    private:
+    [[nodiscard]] WDL solve ( typename Index::PositionData const & p_ ) const noexcept {
+        if ( p_.m_slides and not std::any_of ( std::begin ( p_.m_board ), std::end ( p_.m_board ),
+                                                [] ( auto p ) noexcept { return p.occupied ( ); } ) )
+            return WDL::unknown; // Unreachable, sliding without stones.
+        Mado<R> const state ( p_ );
+        WDL best = WDL::unknown;
+        for ( auto const move : state.availableMoves ( ) ) {
+            best = std::max ( best, value_after ( state, move, m_bits.get ( ) ) );
+            if ( WDL::win == best )
+                break;
+        }
+        return WDL::unknown == best ? WDL::draw : best; // No moves, not a win.
+    }
+
+    void set ( std::uint64_t const i_, WDL const v_ ) noexcept {
+        m_bits[ i_ >> 2 ] |= static_cast<std::uint8_t> ( static_cast<std::uint8_t> ( v_ ) << ( ( i_ & 3u ) << 1 ) );
+    }
+
+    int const m_number_of_threads;
+    std::unique_ptr<std::uint8_t[], decltype ( &std::free )> m_bits;
+};
+
+// The (memory mapped) table.
+template<int R>
+class Probe {
+
+    public:
+    using Index = Index<R>;
+    using Move  = typename Mado<R>::Move;
+
+    explicit Probe ( std::filesystem::path const & path_ ) : m_file ( path_ ) {
+        Header header, expected;
+        if ( m_file.size ( ) < sizeof ( Header ) )
+            throw std::runtime_error ( "Tablebase: not a table " + path_.string ( ) );
+        std::memcpy ( &header, m_file.data ( ), sizeof ( Header ) );
+        if ( std::memcmp ( header.magic, expected.magic, sizeof ( header.magic ) ) or expected.version != header.version or
+             static_cast<std::uint32_t> ( R ) != header.radius or Index::size ( ) != header.entries or
+             m_file.size ( ) < sizeof ( Header ) + header.entries / 4u )
+            throw std::runtime_error ( "Tablebase: wrong table " + path_.string ( ) );
+        m_bits = m_file.data ( ) + sizeof ( Header );
+    }
+
+    [[nodiscard]] WDL probe ( Mado<R> const & state_ ) const noexcept {
+        if ( state_.terminal ( ) ) // The player to move has lost, or it's a draw.
+            return state_.winner ( ).vacant ( ) ? WDL::draw : state_.winner ( ) == state_.playerToMove ( ) ? WDL::win : WDL::loss;
+        return get ( m_bits, Index::index ( state_.position ( ) ) );
+    }
+
+    // A move that keeps the value of the position, i.e. perfect play.
+    [[nodiscard]] Move best_move ( Mado<R> const & state_ ) const noexcept {
+        Move best_move = Mado<R>::no_move;
+        WDL best       = WDL::unknown;
+        for ( auto const move : state_.availableMoves ( ) )
+            if ( WDL const v = value_after ( state_, move, m_bits ); v > best ) {
+                best      = v;
+                best_move = move;
+            }
+        return best_move;
+    }
+
+    private:
+    MappedFile m_file;
+    std::uint8_t const * m_bits = nullptr;
+};
+
+} // namespace Tablebase
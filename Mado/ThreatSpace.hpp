@@ -0,0 +1,195 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Threat-space search, looks for a win by a sequence of threats. A threat is a move
+// that leaves an opponent stone with a single liberty (vacant neighbor), the opponent
+// has to answer it, or lose on the next move. Only threatening moves are tried for the
+// attacker, the defender has to parry every threat, so all of its moves are tried, but
+// most are refuted at once by the attacker surrounding the threatened stone. A search
+// several threats deep only visits a few thousand positions.
+//
+// A move can only surround the stones next to the cell it moves to, so the winning moves
+// are the moves onto the last liberty of an opponent stone, and the threats the moves
+// onto a liberty of an opponent stone that has two.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+
+#include <bitset>
+#include <limits>
+
+namespace ThreatSpace {
+
+template<typename Move>
+struct Result {
+    bool win = false; // for the player to move, proven within the depth.
+    Move move;        // The first move of the win.
+    std::int64_t nodes = 0;
+};
+
+// The vacant cells that are the only liberty (liberties_ == 1), or one of two liberties
+// (liberties_ == 2), of a stone of player_.
+template<typename State>
+[[nodiscard]] std::bitset<State::Board::size ( )> liberties ( State const & state_, typename State::value_type const player_,
+                                                              int const liberties_ ) noexcept {
+    using Board        = typename State::Board;
+    auto const & board = state_.position ( ).m_board;
+    std::bitset<Board::size ( )> cells;
+    for ( int i = 0; i < Board::size ( ); ++i ) {
+        if ( player_ != board[ i ] )
+            continue;
+        int n = 0, l[ 2 ];
+        for ( auto const neighbor : Board::neighbors[ i ] )
+            if ( board[ neighbor ].vacant ( ) and n++ < 2 )
+                l[ n - 1 ] = neighbor;
+        if ( n == liberties_ )
+            for ( int j = 0; j < n; ++j )
+                cells.set ( l[ j ] );
+    }
+    return cells;
+}
+
+// A move that wins at once for the player to move, or State::no_move.
+template<typename State>
+[[nodiscard]] typename State::Move winning_move ( State const & state_, std::int64_t & nodes_ ) noexcept {
+    using Board        = typename State::Board;
+    auto const player  = state_.playerToMove ( );
+    auto const targets = liberties ( state_, player.opponent ( ), 1 );
+    if ( targets.none ( ) )
+        return State::no_move;
+    auto const & board = state_.position ( ).m_board;
+    auto wins          = [ & ] ( typename State::Move const move_ ) noexcept {
+        State child = state_;
+        child.moveWinner ( move_ );
+        ++nodes_;
+        return child.winner ( ) == player;
+    };
+    for ( int to = 0; to < Board::size ( ); ++to ) {
+        if ( not targets.test ( to ) )
+            continue;
+        auto const cell = static_cast<typename State::Move::value_type> ( to );
+        if ( typename State::Move const move{ cell }; wins ( move ) )
+            return move;
+        for ( auto const from : Board::neighbors[ to ] )
+            if ( player == board[ from ] )
+                if ( typename State::Move const move{ from, cell }; wins ( move ) )
+                    return move;
+    }
+    return State::no_move;
+}
+
+template<typename State>
+class Searcher {
+
+    public:
+    using Move  = typename State::Move;
+    using Board = typename State::Board;
+
+    explicit Searcher ( std::int64_t const max_nodes_ ) noexcept : m_max_nodes ( max_nodes_ ) {}
+
+    // Can the player to move win with at most depth_ threats (the winning move not counted)?
+    [[nodiscard]] bool attack ( State const & state_, int const depth_, Move & move_ ) noexcept {
+        if ( Move const move = winning_move ( state_, m_nodes ); move.is_valid ( ) ) {
+            move_ = move;
+            return true;
+        }
+        if ( 0 == depth_ or m_nodes >= m_max_nodes )
+            return false;
+        auto const threats = liberties ( state_, state_.playerToMove ( ).opponent ( ), 2 );
+        if ( threats.none ( ) )
+            return false;
+        for ( auto const move : state_.availableMoves ( ) ) {
+            if ( not threats.test ( move.to ) )
+                continue;
+            State child = state_;
+            child.moveWinner ( move );
+            ++m_nodes;
+            // Not a win (tried above), so a loss or a draw.
+            if ( child.terminal ( ) or liberties ( child, child.playerToMove ( ), 1 ).none ( ) )
+                continue;
+            if ( defend ( child, depth_ - 1 ) ) {
+                move_ = move;
+                return true;
+            }
+        }
+        return false;
+    }
+
+    // Does every move of the player to move lose against the threat?
+    [[nodiscard]] bool defend ( State const & state_, int const depth_ ) noexcept {
+        auto const attacker = state_.playerToMove ( ).opponent ( );
+        for ( auto const move : state_.availableMoves ( ) ) {
+            State child = state_;
+            child.moveWinner ( move );
+            ++m_nodes;
+            if ( child.terminal ( ) ) {
+                if ( child.winner ( ) == attacker )
+                    continue;
+                return false;
+            }
+            Move reply;
+            if ( not attack ( child, depth_, reply ) )
+                return false;
+        }
+        return true;
+    }
+
+    [[nodiscard]] std::int64_t nodes ( ) const noexcept { return m_nodes; }
+
+    private:
+    std::int64_t const m_max_nodes;
+    std::int64_t m_nodes = 0;
+};
+
+// Looks for a win of the player to move, by at most depth_ threats, shortest first.
+template<typename State>
+[[nodiscard]] Result<typename State::Move> search ( State const & state_, int const depth_,
+                                                    std::int64_t const max_nodes_ = 100'000 ) noexcept {
+    Result<typename State::Move> result;
+    if ( state_.terminal ( ) )
+        return result;
+    Searcher<State> searcher ( max_nodes_ );
+    for ( int depth = 0; depth <= depth_ and not result.win and searcher.nodes ( ) < max_nodes_; ++depth )
+        result.win = searcher.attack ( state_, depth, result.move );
+    result.nodes = searcher.nodes ( );
+    return result;
+}
+
+// As State::simulate ( ), but a player that can win by at most depth_ threats does so.
+template<typename State>
+[[maybe_unused]] typename State::value_type simulate ( State & state_, int const depth_,
+                                                       int max_plies_ = std::numeric_limits<int>::max ( ),
+                                                       std::int64_t const max_nodes_ = 1'000 ) noexcept {
+    while ( max_plies_-- > 0 and state_.nonterminal ( ) ) {
+        auto const r    = search ( state_, depth_, max_nodes_ );
+        auto const move  = r.win ? r.move : state_.randomMove ( );
+        if ( not move.is_valid ( ) )
+            break;
+        state_.moveWinner ( move );
+    }
+    return state_.winner ( );
+}
+
+} // namespace ThreatSpace
@@ -0,0 +1,202 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Tuning of the engine parameters by SPSA (simultaneous perturbation stochastic
+// approximation). Every iteration perturbs all tuned parameters at once, by +/- c (a
+// random sign per parameter), plays a match of the plus engine against the minus engine
+// (Arena.hpp), and moves the parameters in the direction of the winner. The parameters
+// are saved to a checkpoint after every iteration, tuning resumes from it.
+//
+// The registry holds the parameters of Mcts::ComputeOptions that can be tuned, the
+// search constants (Mcts::Constants) only in tuning builds (MADO_TUNING defined), in
+// production builds they are compile time constants. Parameter files are text files of
+// "name value" lines, like the weights of StaticEval.
+
+#pragma once
+
+#include <cmath>
+
+#include <algorithm>
+#include <filesystem>
+#include <fstream>
+#include <functional>
+#include <iostream>
+#include <random>
+#include <sstream>
+#include <stdexcept>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "Arena.hpp"
+#include "MonteCarlo.hpp"
+
+namespace Tuning {
+
+struct Parameter {
+    std::string name;
+    float min, max;
+    float step; // the perturbation (c) at the first iteration.
+    std::function<float &( Mcts::ComputeOptions & )> value;
+    std::function<bool ( Mcts::ComputeOptions const & )> active; // iff false, the search ignores the parameter.
+};
+
+[[nodiscard]] inline bool puct ( Mcts::ComputeOptions const & o_ ) noexcept { return nullptr != o_.evaluator; }
+[[nodiscard]] inline bool uct ( Mcts::ComputeOptions const & o_ ) noexcept { return nullptr == o_.evaluator; }
+[[nodiscard]] inline bool cutoff ( Mcts::ComputeOptions const & o_ ) noexcept { return o_.playout_cutoff > 0; }
+[[nodiscard]] inline bool always ( Mcts::ComputeOptions const & ) noexcept { return true; }
+
+[[nodiscard]] inline std::vector<Parameter> const & registry ( ) {
+    static std::vector<Parameter> const parameters = [ ] ( ) {
+        std::vector<Parameter> p{
+            { "c_puct", 0.1f, 8.0f, 0.25f, [] ( Mcts::ComputeOptions & o_ ) -> float & { return o_.c_puct; }, puct },
+#ifdef MADO_TUNING
+            { "uct_exploration", 0.1f, 8.0f, 0.25f,
+              [] ( Mcts::ComputeOptions & o_ ) -> float & { return o_.constants.uct_exploration; }, uct },
+            { "final_prior_wins", 0.0f, 16.0f, 0.5f,
+              [] ( Mcts::ComputeOptions & o_ ) -> float & { return o_.constants.final_prior_wins; }, always },
+            { "final_prior_losses", 0.0f, 16.0f, 0.5f,
+              [] ( Mcts::ComputeOptions & o_ ) -> float & { return o_.constants.final_prior_losses; },
+              always },
+#endif
+        };
+        // The weights of the static evaluation, of the playouts with a cutoff.
+        for ( auto const & e : StaticEval::Weights::entries )
+            p.push_back ( { "evaluation." + std::string{ e.name }, -2.0f, 2.0f, 0.05f,
+                            [ w = e.weight ] ( Mcts::ComputeOptions & o_ ) -> float & { return o_.evaluation.*w; }, cutoff } );
+        return p;
+    }( );
+    return parameters;
+}
+
+[[nodiscard]] inline Parameter const & find ( std::string_view const name_ ) {
+    auto const & r = registry ( );
+    auto const p =
+        std::find_if ( std::begin ( r ), std::end ( r ), [ name_ ] ( Parameter const & p_ ) { return p_.name == name_; } );
+    if ( std::end ( r ) == p )
+        throw std::runtime_error ( "Tuning: no parameter " + std::string{ name_ } + " (in this build)" );
+    return *p;
+}
+
+// Reads the parameters in the file into options_, missing parameters keep their value,
+// # starts a comment. Returns the iteration of a checkpoint, 0 for a parameter file.
+inline int load ( Mcts::ComputeOptions & options_, std::filesystem::path const & path_ ) {
+    std::ifstream istream ( path_ );
+    if ( not istream )
+        throw std::runtime_error ( "Tuning: cannot read " + path_.string ( ) );
+    int iteration = 0;
+    for ( std::string line; std::getline ( istream, line ); ) {
+        line = line.substr ( 0, line.find ( '#' ) );
+        std::istringstream words ( line );
+        std::string name;
+        float value;
+        if ( not( words >> name ) )
+            continue;
+        if ( "iteration" == name ? not( words >> iteration ) : not( words >> value ) )
+            throw std::runtime_error ( "Tuning: bad line \"" + line + "\" in " + path_.string ( ) );
+        if ( "iteration" != name )
+            find ( name ).value ( options_ ) = value;
+    }
+    return iteration;
+}
+
+inline void save ( Mcts::ComputeOptions options_, std::filesystem::path const & path_, int const iteration_ = 0 ) {
+    std::ofstream ostream ( path_, std::ios::trunc );
+    if ( not ostream )
+        throw std::runtime_error ( "Tuning: cannot write " + path_.string ( ) );
+    if ( iteration_ )
+        ostream << "iteration " << iteration_ << '\n';
+    for ( auto const & p : registry ( ) )
+        ostream << p.name << ' ' << p.value ( options_ ) << '\n';
+}
+
+struct Options {
+    std::vector<std::string> parameters; // the names of the tuned parameters, all iff empty.
+    int iterations = 1'000;
+    int games      = 16; // per iteration, the number of games of plus against minus.
+    // The gains, a_k = a / ( k + 1 + A )^alpha, c_k = c / ( k + 1 )^gamma, as recommended by Spall.
+    double a = 1.0, A = 100.0, alpha = 0.602, gamma = 0.101;
+    std::filesystem::path checkpoint = "mado.tune"; // resumed from, iff it exists.
+    Arena::Options arena;
+    bool verbose = true;
+};
+
+// Tunes the parameters of options_, returns the tuned options.
+template<typename State>
+[[nodiscard]] Mcts::ComputeOptions spsa ( Mcts::ComputeOptions options_, Options const & spsa_ = Options{ } ) {
+    std::vector<Parameter const *> tuned;
+    if ( spsa_.parameters.empty ( ) )
+        for ( auto const & p : registry ( ) )
+            tuned.push_back ( std::addressof ( p ) );
+    else
+        for ( auto const & name : spsa_.parameters )
+            tuned.push_back ( std::addressof ( find ( name ) ) );
+    // Tuning a parameter the search ignores, only makes it drift (with the noise of the games).
+    tuned.erase ( std::remove_if ( std::begin ( tuned ), std::end ( tuned ),
+                                   [ &options_ ] ( Parameter const * p_ ) { return not p_->active ( options_ ); } ),
+                  std::end ( tuned ) );
+    if ( tuned.empty ( ) )
+        throw std::runtime_error ( "Tuning: no parameter is active with these options" );
+    options_.verbose     = false;
+    int k                = std::filesystem::exists ( spsa_.checkpoint ) ? load ( options_, spsa_.checkpoint ) : 0;
+    Arena::Options arena = spsa_.arena;
+    arena.max_games      = spsa_.games;
+    arena.sprt           = false;
+    arena.verbose        = false;
+    std::vector<float> c ( tuned.size ( ) ), delta ( tuned.size ( ) );
+    for ( ; k < spsa_.iterations; ++k ) {
+        std::mt19937_64 rng ( spsa_.arena.seed + static_cast<std::uint64_t> ( k ) ); // Resumes reproducibly.
+        Mcts::ComputeOptions plus = options_, minus = options_;
+        for ( std::size_t i = 0; i < tuned.size ( ); ++i ) {
+            Parameter const & p = *tuned[ i ];
+            c[ i ]              = static_cast<float> ( p.step / std::pow ( k + 1.0, spsa_.gamma ) );
+            delta[ i ]          = rng ( ) & 1u ? 1.0f : -1.0f;
+            p.value ( plus )    = std::clamp ( p.value ( options_ ) + c[ i ] * delta[ i ], p.min, p.max );
+            p.value ( minus )   = std::clamp ( p.value ( options_ ) - c[ i ] * delta[ i ], p.min, p.max );
+        }
+        arena.seed = rng ( ); // New openings every iteration.
+        auto const result =
+            Arena::match<State> ( Arena::mcts<State> ( "plus", plus ), Arena::mcts<State> ( "minus", minus ), arena );
+        // The score of plus less the score of minus, estimates f ( plus ) - f ( minus ).
+        double const y = static_cast<double> ( result.score.wins - result.score.losses ) / std::max ( result.score.games ( ), 1 );
+        double const a = spsa_.a / std::pow ( k + 1.0 + spsa_.A, spsa_.alpha );
+        // The gain is scaled by step^2, so all parameters move by about the same number of steps.
+        for ( std::size_t i = 0; i < tuned.size ( ); ++i ) {
+            Parameter const & p  = *tuned[ i ];
+            double const g       = y / ( 2.0 * c[ i ] * delta[ i ] );
+            p.value ( options_ ) = std::clamp ( static_cast<float> ( p.value ( options_ ) + a * p.step * p.step * g ), p.min,
+                                                p.max );
+        }
+        save ( options_, spsa_.checkpoint, k + 1 );
+        if ( spsa_.verbose ) {
+            std::cout << "iteration " << k + 1 << ": " << result.score.wins << '-' << result.score.draws << '-'
+                      << result.score.losses;
+            for ( auto const p : tuned )
+                std::cout << ' ' << p->name << ' ' << p->value ( options_ );
+            std::cout << std::endl;
+        }
+    }
+    return options_;
+}
+
+} // namespace Tuning
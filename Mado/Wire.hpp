@@ -0,0 +1,161 @@
+
+// MIT License
+//
+// Copyright (c) 2019, 2020 degski
+//
+// Permission is hereby granted, free of charge, to any person obtaining a copy
+// of this software and associated documentation files (the "Software"), to deal
+// in the Software without restriction, including without limitation the rights
+// to use, copy, modify, merge, publish, distribute, sublicense, and/or sell
+// copies of the Software, and to permit persons to whom the Software is
+// furnished to do so, subject to the following conditions:
+//
+// The above copyright notice and this permission notice shall be included in all
+// copies or substantial portions of the Software.
+//
+// THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+// IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+// FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT. IN NO EVENT SHALL THE
+// AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+// LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING FROM,
+// OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER DEALINGS IN THE
+// SOFTWARE.
+
+// Fixed (trivially copyable) wire layouts of the hot data types, little endian, unaligned,
+// in stead of cereal's field by field serialization (which is kept, for compatibility).
+// A type is given a layout by specializing Layout ( ), next to the type:
+//
+//     template<> struct Layout<T> {
+//         struct type;                                  // the layout, trivially copyable.
+//         static constexpr std::uint32_t version;      // of the layout.
+//         static constexpr bool identity;              // iff T is its own layout in memory.
+//         static type pack ( T const & );
+//         static void unpack ( type const &, T & );
+//     };
+//
+// A span of records is stored as | header 32 | records |, and is read and written in bulk,
+// with a single memcpy (or write), iff the layout is the identity.
+
+#pragma once
+
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+#include <type_traits>
+#include <vector>
+
+namespace Wire {
+
+#if defined( _WIN32 ) or ( defined( __BYTE_ORDER__ ) and __BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__ )
+inline constexpr bool little_endian = true;
+#else
+inline constexpr bool little_endian = false;
+#endif
+
+// An arithmetic value, little endian, unaligned.
+template<typename T>
+struct Little {
+
+    static_assert ( std::is_arithmetic<T>::value, "only arithmetic values have a byte order" );
+
+    std::uint8_t bytes[ sizeof ( T ) ];
+
+    Little ( ) noexcept = default;
+    Little ( T const v_ ) noexcept {
+        std::memcpy ( bytes, &v_, sizeof ( T ) );
+        if constexpr ( not little_endian )
+            std::reverse ( std::begin ( bytes ), std::end ( bytes ) );
+    }
+
+    [[nodiscard]] operator T ( ) const noexcept {
+        std::uint8_t b[ sizeof ( T ) ];
+        std::memcpy ( b, bytes, sizeof ( T ) );
+        if constexpr ( not little_endian )
+            std::reverse ( std::begin ( b ), std::end ( b ) );
+        T v;
+        std::memcpy ( &v, b, sizeof ( T ) );
+        return v;
+    }
+};
+
+template<typename T>
+struct Layout;
+
+// | magic 8 | version 4 | record size 4 | records 8 | reserved 8 |.
+struct SpanHeader {
+    char magic[ 8 ]                   = { 'M', 'A', 'D', 'O', 'W', 'I', 'R', '\0' };
+    Little<std::uint32_t> version     = 0u; // of the layout of the records.
+    Little<std::uint32_t> record_size = 0u;
+    Little<std::uint64_t> records     = 0u;
+    std::uint8_t reserved[ 8 ]        = { };
+};
+
+static_assert ( sizeof ( SpanHeader ) == 32, "the header is 32 bytes" );
+
+template<typename T>
+void write_span ( std::ostream & out_, T const * const data_, std::size_t const size_ ) {
+    using type = typename Layout<T>::type;
+    static_assert ( not Layout<T>::identity or sizeof ( T ) == sizeof ( type ), "an identity layout is the record itself" );
+    static_assert ( std::is_trivially_copyable<type>::value and 1u == alignof ( type ), "a layout is unaligned bytes" );
+    SpanHeader header;
+    header.version     = Layout<T>::version;
+    header.record_size = static_cast<std::uint32_t> ( sizeof ( type ) );
+    header.records     = static_cast<std::uint64_t> ( size_ );
+    out_.write ( reinterpret_cast<char const *> ( &header ), sizeof ( SpanHeader ) );
+    if constexpr ( Layout<T>::identity ) {
+        out_.write ( reinterpret_cast<char const *> ( data_ ), static_cast<std::streamsize> ( size_ * sizeof ( T ) ) );
+    }
+    else {
+        std::vector<type> buffer ( std::min ( size_, std::size_t{ 4'096 } ) );
+        for ( std::size_t i = 0u; i < size_; i += buffer.size ( ) ) {
+            std::size_t const n = std::min ( buffer.size ( ), size_ - i );
+            for ( std::size_t j = 0u; j < n; ++j )
+                buffer[ j ] = Layout<T>::pack ( data_[ i + j ] );
+            out_.write ( reinterpret_cast<char const *> ( buffer.data ( ) ), static_cast<std::streamsize> ( n * sizeof ( type ) ) );
+        }
+    }
+    if ( not out_ )
+        throw std::runtime_error ( "Wire: cannot write a span" );
+}
+
+template<typename T>
+void write_span ( std::ostream & out_, std::vector<T> const & span_ ) {
+    write_span ( out_, span_.data ( ), span_.size ( ) );
+}
+
+// Reads a span written by write_span ( ), of the same version of the layout.
+template<typename T>
+[[nodiscard]] std::vector<T> read_span ( std::istream & in_ ) {
+    using type = typename Layout<T>::type;
+    static_assert ( not Layout<T>::identity or sizeof ( T ) == sizeof ( type ), "an identity layout is the record itself" );
+    SpanHeader header, expected;
+    in_.read ( reinterpret_cast<char *> ( &header ), sizeof ( SpanHeader ) );
+    if ( not in_ or std::memcmp ( header.magic, expected.magic, sizeof ( header.magic ) ) )
+        throw std::runtime_error ( "Wire: not a span" );
+    if ( Layout<T>::version != header.version or sizeof ( type ) != header.record_size )
+        throw std::runtime_error ( "Wire: wrong version of a span" );
+    std::size_t const size = static_cast<std::size_t> ( static_cast<std::uint64_t> ( header.records ) );
+    std::vector<T> span ( size );
+    if constexpr ( Layout<T>::identity ) {
+        in_.read ( reinterpret_cast<char *> ( span.data ( ) ), static_cast<std::streamsize> ( size * sizeof ( T ) ) );
+    }
+    else {
+        std::vector<type> buffer ( std::min ( size, std::size_t{ 4'096 } ) );
+        for ( std::size_t i = 0u; i < size and in_; i += buffer.size ( ) ) {
+            std::size_t const n = std::min ( buffer.size ( ), size - i );
+            in_.read ( reinterpret_cast<char *> ( buffer.data ( ) ), static_cast<std::streamsize> ( n * sizeof ( type ) ) );
+            for ( std::size_t j = 0u; j < n; ++j )
+                Layout<T>::unpack ( buffer[ j ], span[ i + j ] );
+        }
+    }
+    if ( not in_ )
+        throw std::runtime_error ( "Wire: truncated span" );
+    return span;
+}
+
+} // namespace Wire
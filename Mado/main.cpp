@@ -55,7 +55,13 @@
 #include <plf/plf_nanotimer.h>
 
 #include "../../MCTSSearchTree/include/flat_search_tree.hpp"
-#include "MonteCarlo - dev.hpp"
+#include "Archive.hpp"
+#include "Arena.hpp"
+#include "MonteCarlo.hpp"
+#include "Perft.hpp"
+#include "PositionDb.hpp"
+#include "Tablebase.hpp"
+#include "Tuning.hpp"
 
 #include <emmintrin.h>
 
@@ -184,38 +190,19 @@ int main ( ) {
     sax::enable_virtual_terminal_sequences ( );
     std::ios_base::sync_with_stdio ( false );
     using State = Mado<3>;
-    State state;
-    using Player = typename State::value_type;
-    Player winner;
-    std::uint32_t matches = 0u, agent_wins = 0u, human_wins = 0u;
-    putchar ( '\n' );
-    sf::HrClock::duration elapsed;
-    sf::HrTimePoint match_start;
-    for ( int i = 0; i < 100; ++i ) {
-        {
-            State state;
-            match_start = Clock::instance ( ).now ( );
-            do {
-                state.moveWinner ( Mcts::compute_move ( state, Mcts::ComputeOptions{ } ) );
-                std::cout << nl << state << nl;
-            } while ( state.nonterminal ( ) );
-            winner = state.winner ( );
-        }
-        elapsed += since ( match_start );
-        ++matches;
-        switch ( winner.as_index ( ) ) {
-            case ( int ) Player::Type::agent: ++agent_wins; break;
-            case ( int ) Player::Type::human: ++human_wins; break;
-        }
-        float a = ( 1000.0f * agent_wins ) / float ( agent_wins + human_wins );
-        a       = ( ( int ) a ) / 10.0f;
-        float h = ( 1000.0f * human_wins ) / float ( agent_wins + human_wins );
-        h       = ( ( int ) h ) / 10.0f;
-        printf ( "\r Match %i: Agent%6.1f%% - Human%6.1f%% (%.1f Sec./Match - %.1f Sec.)\n", matches, a, h,
-                 std::chrono::duration_cast<std::chrono::milliseconds> ( elapsed ).count ( ) / ( ( float ) matches * 1'000.0f ),
-                 std::chrono::duration_cast<std::chrono::milliseconds> ( elapsed ).count ( ) / 1'000.0f );
-    }
-
+    // The agent ponders on the time of the human, the games are played concurrently, so
+    // every engine searches with one thread.
+    Mcts::ComputeOptions agent, human;
+    agent.max_time   = human.max_time = 1.0f;
+    agent.max_memory = std::size_t{ 1 } << 28;
+    agent.verbose    = human.verbose = false;
+    auto const book  = Book::open ( g_app_data_path / "mado.book" );
+    agent.book       = book.get ( );
+    Arena::Options options;
+    options.max_games = 1'000;
+    auto const result =
+        Arena::match<State> ( Arena::ponder<State> ( "agent", agent ), Arena::mcts<State> ( "human", human ), options );
+    std::cout << nl << result << " (" << result.seconds << " Sec.)" << nl;
     return EXIT_SUCCESS;
 }
 
@@ -246,6 +233,85 @@ int main67567 ( ) {
     return EXIT_SUCCESS;
 }
 
+// Builds the R = 2 win/draw/loss table (13.9G positions, 3.5GB), cross-checked against
+// df-pn before it is saved.
+int mainTablebase ( ) {
+
+    Tablebase::Builder<2> builder ( static_cast<int> ( getNumberOfProcessors ( ) ) );
+
+    builder.solve ( );
+    builder.verify ( 256, 1 );
+    builder.save ( g_app_data_path / "mado-2.wdl" );
+
+    return EXIT_SUCCESS;
+}
+
+// Validates (and times) the move generation against the reference counts.
+int mainPerft ( ) {
+
+    int const number_of_threads = static_cast<int> ( getNumberOfProcessors ( ) );
+
+    bool passed = Perft::check<Mado<2>> ( number_of_threads );
+    passed      = Perft::check<Mado<3>> ( number_of_threads ) and passed;
+    passed      = Perft::check<Mado<4>> ( number_of_threads ) and passed;
+    passed      = Perft::check<Mado<5>> ( number_of_threads ) and passed;
+
+    return passed ? EXIT_SUCCESS : EXIT_FAILURE;
+}
+
+// Builds the opening book of the first 4 plies, searched for 60 seconds each.
+int mainBook ( ) {
+
+    Mcts::ComputeOptions options;
+    options.max_time          = 60.0f;
+    options.max_iterations    = -1;
+    options.number_of_threads = static_cast<int> ( getNumberOfProcessors ( ) );
+
+    Mcts::build_book<Mado<3>> ( g_app_data_path / "mado.book", 4, options );
+
+    return EXIT_SUCCESS;
+}
+
+// Trains the dictionary (of the archives) on the positions sampled into dict/.
+int mainDictionary ( ) {
+
+    Archive::train<PositionData<3>> ( "dict" ).save ( "mado.dict" );
+
+    return EXIT_SUCCESS;
+}
+
+// Builds the position database of the games recorded in mado.games (Arena::Options::games).
+int mainPositions ( ) {
+
+    PositionDb::build<Mado<3>> ( "mado.games", "mado.positions" );
+
+    PositionDb::Database const database ( "mado.positions" );
+
+    Mado<3> mado;
+    mado.moveHashWinner ( mado.randomMove ( ) );
+
+    if ( auto const entry = database.probe ( mado ) )
+        std::cout << "+" << entry->wins << " =" << entry->draws << " -" << entry->losses << nl;
+
+    return EXIT_SUCCESS;
+}
+
+// Tunes the search (build with MADO_TUNING, to also tune the search constants), resumes
+// from mado.tune, the tuned parameters are written to it.
+int mainTune ( ) {
+
+    Mcts::ComputeOptions options;
+    options.max_time       = 0.1f;
+    options.playout_cutoff = 16; // Scores the playouts by the static evaluation, so its weights are tuned as well.
+
+    Tuning::Options tuning;
+    tuning.arena.concurrency = static_cast<int> ( getNumberOfProcessors ( ) );
+
+    options = Tuning::spsa<Mado<3>> ( options, tuning );
+
+    return EXIT_SUCCESS;
+}
+
 int main786786 ( ) {
 
     sax::enable_virtual_terminal_sequences ( );